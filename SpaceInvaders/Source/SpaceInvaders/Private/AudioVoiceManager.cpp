@@ -0,0 +1,154 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "AudioVoiceManager.h"
+#include "SpaceInvaders.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+#include "Components/AudioComponent.h"
+#include "Sound/SoundBase.h"
+
+void UAudioVoiceManager::Deinitialize()
+{
+	voices.Empty();
+	VoicesOwner = nullptr;
+
+	Super::Deinitialize();
+}
+
+bool UAudioVoiceManager::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+bool UAudioVoiceManager::PlaySound(USoundBase* sound, FVector location, int32 priority)
+{
+	if (!sound)
+		return false;
+
+	if (!IsAudible(location))
+	{
+		INC_DWORD_STAT(STAT_SI_SoundsCulled);
+		return false;
+	}
+
+	// Find a free voice, the oldest voice of this sound and the oldest voice that can be stolen
+	int32 freeVoice = INDEX_NONE;
+	int32 oldestSame = INDEX_NONE;
+	int32 oldestStealable = INDEX_NONE;
+	int32 numSame = 0;
+	for (int32 i = 0; i < voices.Num(); i++)
+	{
+		const FAudioVoice& voice = voices[i];
+		if (!IsPlaying(voice))
+		{
+			if (freeVoice == INDEX_NONE && voice.Component)
+				freeVoice = i;
+			continue;
+		}
+		if (voice.Sound == sound)
+		{
+			++numSame;
+			if (oldestSame == INDEX_NONE || voice.startTime < voices[oldestSame].startTime)
+				oldestSame = i;
+		}
+		if (voice.priority <= priority &&
+			(oldestStealable == INDEX_NONE || voice.startTime < voices[oldestStealable].startTime))
+			oldestStealable = i;
+	}
+
+	int32 target = INDEX_NONE;
+	if (numSame >= maxVoicesPerSound)
+	{
+		if (voices[oldestSame].priority <= priority)
+			target = oldestSame;
+	}
+	else if (freeVoice != INDEX_NONE)
+		target = freeVoice;
+	else if (voices.Num() < maxVoices)
+	{
+		UAudioComponent* component = CreateVoiceComponent();
+		if (component)
+		{
+			target = voices.AddDefaulted();
+			voices[target].Component = component;
+		}
+	}
+	else
+		target = oldestStealable;
+
+	if (target == INDEX_NONE)
+	{
+		INC_DWORD_STAT(STAT_SI_SoundsCulled);
+		return false;
+	}
+
+	FAudioVoice& voice = voices[target];
+	if (voice.Component->IsPlaying())
+		voice.Component->Stop(); // Oldest-stop
+	voice.Component->SetWorldLocation(location);
+	voice.Component->SetSound(sound);
+	voice.Component->Play();
+	voice.Sound = sound;
+	voice.priority = priority;
+	voice.startTime = GetWorld()->GetTimeSeconds();
+	INC_DWORD_STAT(STAT_SI_SoundsPlayed);
+	return true;
+}
+
+int32 UAudioVoiceManager::GetNumPlaying() const
+{
+	int32 count = 0;
+	for (const FAudioVoice& voice : voices)
+		if (IsPlaying(voice))
+			++count;
+	return count;
+}
+
+UAudioComponent* UAudioVoiceManager::CreateVoiceComponent()
+{
+	UWorld* TheWorld = GetWorld();
+	if (!TheWorld)
+		return nullptr;
+
+	if (!VoicesOwner)
+	{
+		FActorSpawnParameters spawnParameters;
+		spawnParameters.ObjectFlags |= RF_Transient;
+		VoicesOwner = TheWorld->SpawnActor<AActor>(AActor::StaticClass(), FTransform::Identity, spawnParameters);
+		if (!VoicesOwner)
+			return nullptr;
+
+		USceneComponent* root = NewObject<USceneComponent>(VoicesOwner, TEXT("VoicesRoot"));
+		VoicesOwner->SetRootComponent(root);
+		root->RegisterComponent();
+	}
+
+	UAudioComponent* component = NewObject<UAudioComponent>(VoicesOwner);
+	component->bAutoActivate = false;
+	component->bAutoDestroy = false; // Reused by later requests
+	component->SetupAttachment(VoicesOwner->GetRootComponent());
+	component->RegisterComponent();
+	return component;
+}
+
+bool UAudioVoiceManager::IsAudible(const FVector& location) const
+{
+	if (cullDistance <= 0.0f)
+		return true;
+
+	APlayerController* controller = GetWorld()->GetFirstPlayerController();
+	if (!controller)
+		return true;
+
+	FVector listener;
+	FVector front;
+	FVector right;
+	controller->GetAudioListenerPosition(listener, front, right);
+	return FVector::DistSquared(listener, location) <= FMath::Square(cullDistance);
+}
+
+bool UAudioVoiceManager::IsPlaying(const FAudioVoice& voice)
+{
+	return voice.Component && voice.Component->IsPlaying();
+}
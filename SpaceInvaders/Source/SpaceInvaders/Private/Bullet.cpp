@@ -3,26 +3,24 @@
 
 #include "Bullet.h"
 #include "Components/StaticMeshComponent.h"
-#include "Engine/Engine.h"
+#include "Engine/StaticMesh.h"
 #include "UObject/ConstructorHelpers.h"
 
 
 ABullet::ABullet()
 	: bulletType{BulletType::PLAYER},
-	  dir{},
-	  velocity{0.0f}
+	  lifetime{5.0f}
 
 {
-	// Set this actor to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
-	PrimaryActorTick.bCanEverTick = true;
+	// Bullets are moved by the UBulletManager
+	PrimaryActorTick.bCanEverTick = false;
 	Mesh = CreateDefaultSubobject<UStaticMeshComponent>("BaseMeshComponent");
 
 	RootComponent = Mesh; // We need a RootComponent to have a base transform
 	SetBulletMesh();
 
-
-	//Bullets will overlap, blocking behaviour is not desirable
-	Mesh->SetCollisionResponseToAllChannels(ECollisionResponse::ECR_Overlap);
+	Mesh->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	Mesh->SetGenerateOverlapEvents(false);
 }
 
 void ABullet::SetBulletMesh(UStaticMesh* staticMesh, FString path, FVector scale)
@@ -46,30 +44,10 @@ void ABullet::SetBulletMesh(UStaticMesh* staticMesh, FString path, FVector scale
 	}
 }
 
-// Called when the game starts or when spawned
-void ABullet::BeginPlay()
-{
-	Super::BeginPlay();
-}
-
-void ABullet::Tick(float DeltaTime)
+float ABullet::GetHitRadius() const
 {
-	Super::Tick(DeltaTime);
-	FVector location = GetActorLocation();
-	location += DeltaTime * velocity * dir;
-	SetActorLocation(location);
-	// GEngine->AddOnScreenDebugMessage(-1, 10, FColor::White, FString::Printf(TEXT("velocity %f"),velocity));
-}
-
-void ABullet::NotifyActorBeginOverlap(AActor* OtherActor)
-{
-	// Debug
-	// GEngine->AddOnScreenDebugMessage(-1, 1, FColor::Red, FString::Printf(TEXT("%s overlaped me"), *(OtherActor->GetName())));
-	// GEngine->AddOnScreenDebugMessage(-1, 10, FColor::White, FString::Printf(TEXT("Hola, mundo!")));
-
-	for (FName tag : autoDestroyTags)
-	{
-		if (OtherActor->ActorHasTag(tag))
-			Destroy();
-	}
+	UStaticMesh* staticMesh = Mesh ? Mesh->GetStaticMesh() : nullptr;
+	if (!staticMesh)
+		return 0.0f;
+	return staticMesh->GetBounds().SphereRadius * Mesh->GetRelativeScale3D().GetAbsMax();
 }
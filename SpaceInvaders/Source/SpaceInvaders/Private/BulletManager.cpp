@@ -0,0 +1,387 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "BulletManager.h"
+#include "SpaceInvaders.h"
+#include "Invader.h"
+#include "SIPawn.h"
+#include "FrameTimings.h"
+#include "Engine/World.h"
+#include "Components/StaticMeshComponent.h"
+#include "Components/InstancedStaticMeshComponent.h"
+#include "Kismet/GameplayStatics.h"
+#include "HAL/IConsoleManager.h"
+
+void UBulletManager::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	pools.SetNum(StaticEnum<BulletType>()->NumEnums() - 1); // Last enum entry is the hidden _MAX
+}
+
+void UBulletManager::Deinitialize()
+{
+	// Report the occupancy so the prewarm counts can be tuned
+	for (int32 i = 0; i < pools.Num(); i++)
+	{
+		const FBulletPoolStats& stats = pools[i].stats;
+		if (stats.capacity > 0)
+			UE_LOG(LogSpaceInvaders, Log, TEXT("Bullet pool %s: capacity %d, high-water mark %d, overflow spawns %d"),
+		       *StaticEnum<BulletType>()->GetNameStringByIndex(i), stats.capacity, stats.highWaterMark,
+		       stats.overflowSpawns);
+	}
+	pools.Empty();
+	bullets = FBulletArrays();
+	invaders.Empty();
+
+	Super::Deinitialize();
+}
+
+void UBulletManager::OnWorldBeginPlay(UWorld& InWorld)
+{
+	Super::OnWorldBeginPlay(InWorld);
+
+	FindPlayField();
+}
+
+void UBulletManager::FindPlayField()
+{
+	// Without a limit the field is open on that side
+	playField = FBox2D(FVector2D(-UE_BIG_NUMBER), FVector2D(UE_BIG_NUMBER));
+
+	TArray<AActor*> limits;
+	FVector origin;
+	FVector extent;
+	for (int32 side = 0; side < 4; side++)
+	{
+		UGameplayStatics::GetAllActorsWithTag(GetWorld(), FName(limitTags[side]), limits);
+		for (AActor* limit : limits)
+		{
+			// Inner face of the limit volume
+			limit->GetActorBounds(false, origin, extent);
+			switch (side)
+			{
+			case 0: // Left
+				playField.Min.Y = FMath::Max(playField.Min.Y, origin.Y + extent.Y);
+				break;
+			case 1: // Right
+				playField.Max.Y = FMath::Min(playField.Max.Y, origin.Y - extent.Y);
+				break;
+			case 2: // Bottom
+				playField.Min.X = FMath::Max(playField.Min.X, origin.X + extent.X);
+				break;
+			default: // Top
+				playField.Max.X = FMath::Min(playField.Max.X, origin.X - extent.X);
+			}
+		}
+	}
+	playField.bIsValid = true;
+}
+
+bool UBulletManager::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+bool UBulletManager::SetupPool(FBulletPool& pool, TSubclassOf<ABullet> bulletClass)
+{
+	if (pool.Instances)
+		return true;
+
+	UWorld* TheWorld = GetWorld();
+	if (!TheWorld)
+		return false;
+
+	pool.bulletClass = bulletClass ? bulletClass : TSubclassOf<ABullet>(ABullet::StaticClass());
+	const ABullet* archetype = pool.bulletClass->GetDefaultObject<ABullet>();
+	pool.hitRadius = archetype->GetHitRadius();
+	pool.lifetime = archetype->lifetime;
+	pool.meshScale = archetype->Mesh ? archetype->Mesh->GetRelativeScale3D() : FVector::OneVector;
+
+	// The subsystem is not an actor, the instanced meshes need one to live in
+	if (!InstancesOwner)
+	{
+		FActorSpawnParameters spawnParameters;
+		spawnParameters.ObjectFlags |= RF_Transient;
+		InstancesOwner = TheWorld->SpawnActor<AActor>(AActor::StaticClass(), FTransform::Identity, spawnParameters);
+		if (!InstancesOwner)
+			return false;
+
+		USceneComponent* root = NewObject<USceneComponent>(InstancesOwner, TEXT("BulletsRoot"));
+		InstancesOwner->SetRootComponent(root);
+		root->RegisterComponent();
+	}
+
+	UInstancedStaticMeshComponent* ism = NewObject<UInstancedStaticMeshComponent>(InstancesOwner);
+	ism->SetMobility(EComponentMobility::Movable);
+	ism->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	ism->SetGenerateOverlapEvents(false);
+	if (archetype->Mesh)
+	{
+		ism->SetStaticMesh(archetype->Mesh->GetStaticMesh());
+		for (int32 m = 0; m < archetype->Mesh->GetNumMaterials(); m++)
+			ism->SetMaterial(m, archetype->Mesh->GetMaterial(m));
+	}
+	ism->SetupAttachment(InstancesOwner->GetRootComponent());
+	ism->RegisterComponent();
+	pool.Instances = ism;
+	return true;
+}
+
+void UBulletManager::GrowInstances(FBulletPool& pool, int32 count)
+{
+	int32 current = pool.Instances->GetInstanceCount();
+	if (current < count)
+	{
+		// New instances start hidden (zero scale)
+		TArray<FTransform> hidden;
+		hidden.Init(FTransform(FQuat::Identity, FVector::ZeroVector, FVector::ZeroVector), count - current);
+		pool.Instances->AddInstances(hidden, false, true);
+	}
+	pool.stats.capacity = FMath::Max(pool.stats.capacity, count);
+
+	int32 totalCapacity = 0;
+	for (const FBulletPool& other : pools)
+		totalCapacity += other.stats.capacity;
+	bullets.Reserve(totalCapacity);
+}
+
+void UBulletManager::Prewarm(TSubclassOf<ABullet> bulletClass, BulletType bulletType, int32 count)
+{
+	if (!pools.IsValidIndex((int32)bulletType))
+		return;
+
+	FBulletPool& pool = pools[(int32)bulletType];
+	if (SetupPool(pool, bulletClass))
+		GrowInstances(pool, count);
+}
+
+void UBulletManager::FireBullet(TSubclassOf<ABullet> bulletClass, BulletType bulletType, FVector location,
+                                FRotator rotation, FVector dir, float velocity)
+{
+	if (!pools.IsValidIndex((int32)bulletType))
+		return;
+
+	FBulletPool& pool = pools[(int32)bulletType];
+	if (!SetupPool(pool, bulletClass))
+		return;
+
+	if (pool.stats.inUse >= pool.stats.capacity)
+	{
+		++pool.stats.overflowSpawns;
+		GrowInstances(pool, FMath::Max(2 * pool.stats.capacity, 16));
+	}
+
+	bullets.Add(location, rotation.Quaternion(), dir, velocity, pool.lifetime, bulletType);
+	INC_DWORD_STAT(STAT_SI_BulletsFired);
+
+	++pool.stats.inUse;
+	pool.stats.highWaterMark = FMath::Max(pool.stats.highWaterMark, pool.stats.inUse);
+}
+
+void UBulletManager::RemoveBullet(int32 index)
+{
+	--pools[(int32)bullets.owner[index]].stats.inUse;
+	bullets.RemoveAtSwap(index);
+}
+
+int32 UBulletManager::GetNumBullets() const
+{
+	return bullets.Num();
+}
+
+FBulletPoolStats UBulletManager::GetPoolStats(BulletType bulletType) const
+{
+	if (!pools.IsValidIndex((int32)bulletType))
+		return FBulletPoolStats();
+	return pools[(int32)bulletType].stats;
+}
+
+void UBulletManager::RegisterInvader(AInvader* invader)
+{
+	invaders.AddUnique(invader);
+}
+
+void UBulletManager::UnregisterInvader(AInvader* invader)
+{
+	invaders.RemoveSingleSwap(invader, EAllowShrinking::No);
+}
+
+void UBulletManager::RegisterPlayer(ASIPawn* pawn)
+{
+	PlayerPawn = pawn;
+}
+
+TStatId UBulletManager::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UBulletManager, STATGROUP_Tickables);
+}
+
+void UBulletManager::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	{
+		SI_SCOPE_CYCLE_COUNTER(STAT_SI_BulletIntegrate);
+		FScopedFrameSection section(EFrameSection::Bullets);
+		bullets.Integrate(DeltaTime);
+	}
+	{
+		SI_SCOPE_CYCLE_COUNTER(STAT_SI_HitTests);
+		FScopedFrameSection section(EFrameSection::HitTests);
+		ResolveHits();
+	}
+	{
+		SI_SCOPE_CYCLE_COUNTER(STAT_SI_BulletInstances);
+		FScopedFrameSection section(EFrameSection::Bullets);
+		UpdateInstances();
+	}
+
+	SET_DWORD_STAT(STAT_SI_LiveInvaders, invaders.Num());
+	SET_DWORD_STAT(STAT_SI_LiveBullets, bullets.Num());
+}
+
+void UBulletManager::ResolveHits()
+{
+	if (pools.Num() < 2)
+		return;
+
+	// Grid with the live invaders
+	hitPass.playField = playField;
+	hitPass.playerFaction = BulletType::PLAYER;
+	hitPass.playerBulletRadius = pools[(int32)BulletType::PLAYER].hitRadius;
+	hitPass.invaderBulletRadius = pools[(int32)BulletType::INVADER].hitRadius;
+	hitPass.Begin(hitGridCellSize, invaders.Num());
+	hitTargets.Reset();
+	for (AInvader* invader : invaders)
+	{
+		if (!IsValid(invader) || invader->IsDying() || invader->IsHidden())
+			continue; // Hidden: its squad is still being spawned
+		hitPass.AddInvader(hitTargets.Add(invader), FVector2D(invader->GetActorLocation()), invader->GetBoundRadius(),
+		                   invader->IsFreeJumping());
+	}
+
+	FHitPassPlayer player;
+	player.bHittable = IsValid(PlayerPawn) && !PlayerPawn->IsFrozen();
+	if (player.bHittable)
+	{
+		player.location = FVector2D(PlayerPawn->GetActorLocation());
+		player.radius = PlayerPawn->GetSimpleCollisionRadius();
+	}
+
+	hitPass.Resolve(bullets, player,
+	                [this](int32 index) { RemoveBullet(index); },
+	                [this](int32 id) { return !hitTargets[id]->IsDying(); },
+	                [this](int32 id) { hitTargets[id]->HitByBullet(); },
+	                [this]() { PlayerPawn->PlayerHit(); });
+
+	// Removing invaders unregisters them, so it is done once nothing iterates over them
+	for (int32 id : hitPass.GetLeaving())
+	{
+		if (IsValid(hitTargets[id]))
+			hitTargets[id]->SilentDestroy();
+	}
+}
+
+void UBulletManager::UpdateInstances()
+{
+	for (FBulletPool& pool : pools)
+		pool.instanceTransforms.Reset();
+
+	for (int32 i = 0; i < bullets.Num(); i++)
+	{
+		FBulletPool& pool = pools[(int32)bullets.owner[i]];
+		pool.instanceTransforms.Emplace(FQuat(bullets.rotation[i]), bullets.GetLocation(i), pool.meshScale);
+	}
+
+	for (FBulletPool& pool : pools)
+	{
+		if (!pool.Instances)
+			continue;
+
+		// Instances used last frame and not now are hidden, the ones above them already are
+		int32 numBullets = pool.instanceTransforms.Num();
+		int32 numUpdated = FMath::Max(numBullets, pool.visibleInstances);
+		if (numUpdated == 0)
+			continue;
+
+		pool.instanceTransforms.SetNum(numUpdated, EAllowShrinking::No);
+		for (int32 i = numBullets; i < numUpdated; i++)
+			pool.instanceTransforms[i] = FTransform(FQuat::Identity, FVector::ZeroVector, FVector::ZeroVector);
+		pool.Instances->BatchUpdateInstancesTransforms(0, pool.instanceTransforms, true, true, true);
+		pool.visibleInstances = numBullets;
+	}
+}
+
+// Hit test benchmark: "SI.HitTestBenchmark [targets]" compares the spatial hash against testing every
+// bullet with every target, for a formation of synthetic targets and growing bullet counts.
+static void RunHitTestBenchmark(const TArray<FString>& Args)
+{
+	const int32 numTargets = Args.Num() > 0 ? FMath::Max(FCString::Atoi(*Args[0]), 1) : 1000;
+	const float targetRadius = 50.0f;
+	const float bulletRadius = 10.0f;
+	const int32 repetitions = 20;
+
+	// Targets in a square formation, bullets spread over the same area
+	TArray<FVector2D> targets;
+	const int32 side = FMath::CeilToInt32(FMath::Sqrt((float)numTargets));
+	for (int32 i = 0; i < numTargets; i++)
+		targets.Add(FVector2D((i / side) * 3.0f * targetRadius, (i % side) * 3.0f * targetRadius));
+	const float extent = side * 3.0f * targetRadius;
+
+	FRandomStream random(1234);
+	FSpatialHash grid;
+	for (int32 numBullets = 64; numBullets <= 4096; numBullets *= 4)
+	{
+		TArray<FVector2D> bullets;
+		for (int32 i = 0; i < numBullets; i++)
+			bullets.Add(FVector2D(random.FRandRange(0.0f, extent), random.FRandRange(0.0f, extent)));
+
+		int32 bruteHits = 0;
+		double start = FPlatformTime::Seconds();
+		for (int32 r = 0; r < repetitions; r++)
+		{
+			bruteHits = 0;
+			for (const FVector2D& bullet : bullets)
+			{
+				for (const FVector2D& target : targets)
+				{
+					if (FVector2D::DistSquared(bullet, target) <= FMath::Square(targetRadius + bulletRadius))
+					{
+						++bruteHits;
+						break;
+					}
+				}
+			}
+		}
+		double bruteMs = (FPlatformTime::Seconds() - start) * 1000.0 / repetitions;
+
+		int32 gridHits = 0;
+		start = FPlatformTime::Seconds();
+		for (int32 r = 0; r < repetitions; r++)
+		{
+			// The rebuild is part of the cost, the manager does it every frame
+			grid.Reset(4.0f * targetRadius, targets.Num());
+			for (int32 i = 0; i < targets.Num(); i++)
+				grid.Add(i, targets[i], targetRadius);
+			grid.Build();
+
+			gridHits = 0;
+			for (const FVector2D& bullet : bullets)
+			{
+				if (grid.FindOverlap(bullet, bulletRadius, [](int32) { return true; }) != INDEX_NONE)
+					++gridHits;
+			}
+		}
+		double gridMs = (FPlatformTime::Seconds() - start) * 1000.0 / repetitions;
+
+		UE_LOG(LogSpaceInvaders, Display,
+		       TEXT("Hit test: %d targets, %d bullets: brute force %.3f ms (%d hits), spatial hash %.3f ms (%d hits)"),
+		       numTargets, numBullets, bruteMs, bruteHits, gridMs, gridHits);
+	}
+}
+
+static FAutoConsoleCommand HitTestBenchmarkCommand(
+	TEXT("SI.HitTestBenchmark"),
+	TEXT("Times the bullet hit tests (spatial hash vs brute force). Usage: SI.HitTestBenchmark [targets]"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&RunHitTestBenchmark));
@@ -0,0 +1,236 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "EffectManager.h"
+#include "SpaceInvaders.h"
+#include "Engine/World.h"
+#include "NiagaraComponent.h"
+#include "NiagaraSystem.h"
+
+void UEffectManager::Deinitialize()
+{
+	pools.Empty();
+	pending.Empty();
+	EffectsOwner = nullptr;
+	numActive = 0;
+
+	Super::Deinitialize();
+}
+
+bool UEffectManager::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+TStatId UEffectManager::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UEffectManager, STATGROUP_Tickables);
+}
+
+void UEffectManager::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	if (pending.IsEmpty())
+		return;
+
+	// Oldest first; whatever does not fit in this frame's budget waits for the next one
+	const double now = GetWorld()->GetTimeSeconds();
+	int32 kept = 0;
+	for (int32 i = 0; i < pending.Num(); i++)
+	{
+		if (now - pending[i].requestTime > maxQueueDelay)
+		{
+			INC_DWORD_STAT(STAT_SI_EffectsDropped);
+			continue;
+		}
+		if (!TryActivate(pending[i]))
+			pending[kept++] = pending[i];
+	}
+	pending.SetNum(kept, EAllowShrinking::No);
+}
+
+void UEffectManager::Prewarm(UNiagaraSystem* system, int32 count)
+{
+	FEffectPool* pool = FindOrAddPool(system);
+	if (!pool)
+		return;
+
+	while (pool->Components.Num() < count)
+	{
+		if (!CreateComponent(*pool))
+			return;
+	}
+}
+
+void UEffectManager::SpawnEffect(UNiagaraSystem* system, FVector location, FRotator rotation)
+{
+	if (!system)
+		return;
+
+	FPendingEffect effect;
+	effect.System = system;
+	effect.location = location;
+	effect.rotation = rotation;
+	effect.requestTime = GetWorld()->GetTimeSeconds();
+	if (!pending.IsEmpty() || !TryActivate(effect))
+		pending.Add(effect); // Keeps the order of the requests
+}
+
+int32 UEffectManager::GetNumActive() const
+{
+	return numActive;
+}
+
+void UEffectManager::BeginFrame()
+{
+	if (activationFrame != GFrameCounter)
+	{
+		activationFrame = GFrameCounter;
+		activationsThisFrame = 0;
+		startedThisFrame.Reset();
+	}
+}
+
+bool UEffectManager::TryActivate(const FPendingEffect& effect)
+{
+	BeginFrame();
+
+	for (const FPendingEffect& started : startedThisFrame)
+	{
+		if (started.System == effect.System
+			&& FVector::DistSquared(started.location, effect.location) <= FMath::Square(mergeRadius))
+		{
+			INC_DWORD_STAT(STAT_SI_EffectsMerged);
+			return true;
+		}
+	}
+
+	if (activationsThisFrame >= maxActivationsPerFrame)
+		return false;
+
+	FEffectPool* pool = FindOrAddPool(effect.System);
+	if (!pool)
+		return true;
+
+	// When every effect slot is taken the oldest effect of any system makes room
+	int32 index = INDEX_NONE;
+	if (numActive >= maxActiveEffects)
+	{
+		FEffectPool* oldestPool = nullptr;
+		int32 oldest = INDEX_NONE;
+		for (FEffectPool& other : pools)
+		{
+			for (int32 i = 0; i < other.Components.Num(); i++)
+			{
+				if (other.playing[i] && (!oldestPool || other.startTimes[i] < oldestPool->startTimes[oldest]))
+				{
+					oldestPool = &other;
+					oldest = i;
+				}
+			}
+		}
+		if (oldestPool == pool)
+			index = oldest; // Restarted below
+		else if (oldestPool)
+			StopEffect(*oldestPool, oldest);
+	}
+
+	// Otherwise a finished component of this system, or a new one
+	if (index == INDEX_NONE)
+	{
+		index = pool->playing.Find(false);
+		if (index == INDEX_NONE && CreateComponent(*pool))
+			index = pool->Components.Num() - 1;
+	}
+
+	if (index == INDEX_NONE)
+	{
+		INC_DWORD_STAT(STAT_SI_EffectsDropped);
+		return true;
+	}
+
+	UNiagaraComponent* component = pool->Components[index];
+	component->SetWorldLocationAndRotation(effect.location, effect.rotation);
+	component->Activate(true); // Restarts it if it was still playing
+	pool->startTimes[index] = GetWorld()->GetTimeSeconds();
+	if (component->IsActive() && !pool->playing[index])
+	{
+		pool->playing[index] = true;
+		++numActive;
+	}
+
+	++activationsThisFrame;
+	startedThisFrame.Add(effect);
+	INC_DWORD_STAT(STAT_SI_EffectsStarted);
+	return true;
+}
+
+void UEffectManager::StopEffect(FEffectPool& pool, int32 index)
+{
+	pool.playing[index] = false;
+	--numActive;
+	pool.Components[index]->DeactivateImmediate();
+}
+
+void UEffectManager::OnEffectFinished(UNiagaraComponent* component)
+{
+	for (FEffectPool& pool : pools)
+	{
+		int32 index = pool.Components.Find(component);
+		if (index == INDEX_NONE)
+			continue;
+		if (pool.playing[index])
+		{
+			pool.playing[index] = false;
+			--numActive;
+		}
+		return;
+	}
+}
+
+FEffectPool* UEffectManager::FindOrAddPool(UNiagaraSystem* system)
+{
+	if (!system)
+		return nullptr;
+
+	for (FEffectPool& pool : pools)
+		if (pool.System == system)
+			return &pool;
+
+	FEffectPool& pool = pools.AddDefaulted_GetRef();
+	pool.System = system;
+	return &pool;
+}
+
+UNiagaraComponent* UEffectManager::CreateComponent(FEffectPool& pool)
+{
+	UWorld* TheWorld = GetWorld();
+	if (!TheWorld)
+		return nullptr;
+
+	if (!EffectsOwner)
+	{
+		FActorSpawnParameters spawnParameters;
+		spawnParameters.ObjectFlags |= RF_Transient;
+		EffectsOwner = TheWorld->SpawnActor<AActor>(AActor::StaticClass(), FTransform::Identity, spawnParameters);
+		if (!EffectsOwner)
+			return nullptr;
+
+		USceneComponent* root = NewObject<USceneComponent>(EffectsOwner, TEXT("EffectsRoot"));
+		EffectsOwner->SetRootComponent(root);
+		root->RegisterComponent();
+	}
+
+	UNiagaraComponent* component = NewObject<UNiagaraComponent>(EffectsOwner);
+	component->SetAsset(pool.System);
+	component->SetAutoActivate(false);
+	component->SetAutoDestroy(false); // Finished effects stay in the pool
+	component->OnSystemFinished.AddDynamic(this, &UEffectManager::OnEffectFinished);
+	component->SetupAttachment(EffectsOwner->GetRootComponent());
+	component->RegisterComponent();
+	pool.Components.Add(component);
+	pool.startTimes.Add(0.0);
+	pool.playing.Add(false);
+	return component;
+}
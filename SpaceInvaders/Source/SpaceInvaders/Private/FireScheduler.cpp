@@ -0,0 +1,69 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "FireScheduler.h"
+
+float FFireScheduler::SampleDelay(float rate, float u)
+{
+	if (rate <= 0.0f)
+		return UE_BIG_NUMBER;
+
+	// Survival S(t) = exp(-rate * t^2 / (2 * referenceFrameTime)) = 1 - u
+	float survival = FMath::Max(1.0f - u, UE_SMALL_NUMBER);
+	return FMath::Sqrt(-2.0f * referenceFrameTime * FMath::Loge(survival) / rate);
+}
+
+void FFireScheduler::Reset(int32 numSlots)
+{
+	heap.Reset();
+	generations.Init(0, numSlots);
+	scheduled.Init(false, numSlots);
+	numScheduled = 0;
+}
+
+void FFireScheduler::Schedule(int32 slot, float fireTime)
+{
+	if (!scheduled.IsValidIndex(slot))
+		return;
+
+	if (!scheduled[slot])
+	{
+		scheduled[slot] = true;
+		++numScheduled;
+	}
+	heap.HeapPush(FShot{fireTime, slot, ++generations[slot]});
+
+	if (heap.Num() > 2 * numScheduled + 16)
+		Compact();
+}
+
+void FFireScheduler::Cancel(int32 slot)
+{
+	if (!IsScheduled(slot))
+		return;
+
+	scheduled[slot] = false;
+	--numScheduled;
+}
+
+int32 FFireScheduler::PopDue(float now)
+{
+	FShot shot;
+	while (heap.Num() > 0 && (IsStale(heap.HeapTop()) || heap.HeapTop().time <= now))
+	{
+		heap.HeapPop(shot, EAllowShrinking::No);
+		if (!IsStale(shot))
+		{
+			scheduled[shot.slot] = false;
+			--numScheduled;
+			return shot.slot;
+		}
+	}
+	return INDEX_NONE;
+}
+
+void FFireScheduler::Compact()
+{
+	heap.RemoveAllSwap([this](const FShot& shot) { return IsStale(shot); }, EAllowShrinking::No);
+	heap.Heapify();
+}
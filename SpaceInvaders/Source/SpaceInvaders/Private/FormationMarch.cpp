@@ -0,0 +1,99 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "FormationMarch.h"
+#include "FormationSlots.h"
+
+void FFormationLayout::InitGrid(int32 numColumns, int32 numRows, float separation, float radius)
+{
+	columnOffsets.SetNumUninitialized(numColumns);
+	for (int32 i = 0; i < numColumns; i++)
+		columnOffsets[i] = i * separation;
+	rowOffsets.SetNumUninitialized(numRows);
+	for (int32 j = 0; j < numRows; j++)
+		rowOffsets[j] = j * separation;
+	memberRadius = radius;
+}
+
+FVector2D FFormationLayout::GetSlotOffset(const FFormationSlots& slots, int32 slot) const
+{
+	return FVector2D(rowOffsets[slots.GetRow(slot)], columnOffsets[slots.GetColumn(slot)]);
+}
+
+bool FFormationLayout::GetBounds(const FFormationSlots& slots, const FVector2D& origin, FBox2D& bounds) const
+{
+	int32 firstColumn = slots.FirstColumnInFormation();
+	int32 lastColumn = slots.LastColumnInFormation();
+	int32 frontRow = slots.FirstRowInFormation();
+	if (firstColumn == INDEX_NONE || frontRow == INDEX_NONE)
+		return false;
+
+	bounds.Min = FVector2D(origin.X + rowOffsets[frontRow] - memberRadius,
+	                       origin.Y + columnOffsets[firstColumn] - memberRadius);
+	bounds.Max = FVector2D(UE_BIG_NUMBER, origin.Y + columnOffsets[lastColumn] + memberRadius);
+	bounds.bIsValid = true;
+	return true;
+}
+
+FVector2D FFormationMarch::Step(float delta, float horizontalVelocity, float verticalVelocity, float descendingStep)
+{
+	// Right is +Y, down is -X
+	FVector2D offset = FVector2D::ZeroVector;
+	switch (phase)
+	{
+	case EMarchPhase::Right:
+		offset.Y = horizontalVelocity * delta;
+		break;
+	case EMarchPhase::Left:
+		offset.Y = -horizontalVelocity * delta;
+		break;
+	case EMarchPhase::Down:
+		{
+			// The descent is a squad phase: it ends when the squad root has covered descendingStep
+			float step = FMath::Min(verticalVelocity * delta, descendingStep - descendingProgress);
+			offset.X = -step;
+			descendingProgress += step;
+			if (descendingProgress >= descendingStep)
+			{
+				// Walk back to the other side
+				switch (sidePhase)
+				{
+				case EMarchPhase::Right:
+					phase = EMarchPhase::Left;
+					break;
+				case EMarchPhase::Left:
+					phase = EMarchPhase::Right;
+					break;
+				default:
+					phase = EMarchPhase::Stop;
+				}
+			}
+		}
+		break;
+	default:
+		break;
+	}
+	return offset;
+}
+
+void FFormationMarch::StartDescent(EMarchPhase side)
+{
+	sidePhase = side;
+	phase = EMarchPhase::Down;
+	descendingProgress = 0.0f;
+}
+
+bool FFormationMarch::CheckLimits(const FBox2D& bounds, const FBox2D& playField)
+{
+	if (phase == EMarchPhase::Right && bounds.Max.Y >= playField.Max.Y)
+		StartDescent(EMarchPhase::Right);
+	else if (phase == EMarchPhase::Left && bounds.Min.Y <= playField.Min.Y)
+		StartDescent(EMarchPhase::Left);
+
+	if (!bLanded && bounds.Min.X <= playField.Min.X)
+	{
+		bLanded = true;
+		return true;
+	}
+	return false;
+}
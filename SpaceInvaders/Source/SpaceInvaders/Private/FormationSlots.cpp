@@ -0,0 +1,111 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "FormationSlots.h"
+
+void FFormationSlots::Reset(int32 numColumns, int32 numRows)
+{
+	int32 capacity = numColumns * numRows;
+	alive.Empty(capacity);
+	inFormation.Empty(capacity);
+	freeJumping.Empty(capacity);
+	numAlive = 0;
+	numInFormation = 0;
+
+	rowsPerColumn = FMath::Max(numRows, 1);
+	columnCount.Init(0, numColumns);
+	rowCount.Init(0, numRows);
+	columnsInFormation.Init(false, numColumns);
+	rowsInFormation.Init(false, numRows);
+}
+
+int32 FFormationSlots::Add()
+{
+	int32 slot = alive.Add(true);
+	inFormation.Add(true);
+	freeJumping.Add(false);
+	++numAlive;
+	++numInFormation;
+
+	int32 column = GetColumn(slot);
+	int32 row = GetRow(slot);
+	if (columnCount.IsValidIndex(column) && rowCount.IsValidIndex(row))
+	{
+		++columnCount[column];
+		++rowCount[row];
+		columnsInFormation[column] = true;
+		rowsInFormation[row] = true;
+	}
+	return slot;
+}
+
+void FFormationSlots::LeaveFormation(int32 slot)
+{
+	inFormation[slot] = false;
+	--numInFormation;
+
+	int32 column = GetColumn(slot);
+	int32 row = GetRow(slot);
+	if (columnCount.IsValidIndex(column) && rowCount.IsValidIndex(row))
+	{
+		if (--columnCount[column] == 0)
+			columnsInFormation[column] = false;
+		if (--rowCount[row] == 0)
+			rowsInFormation[row] = false;
+	}
+}
+
+bool FFormationSlots::MarkDead(int32 slot)
+{
+	if (!IsAlive(slot))
+		return false; // Already removed
+
+	alive[slot] = false;
+	freeJumping[slot] = false;
+	--numAlive;
+	if (inFormation[slot])
+		LeaveFormation(slot);
+	return true;
+}
+
+bool FFormationSlots::MarkFreeJump(int32 slot)
+{
+	if (!IsInFormation(slot))
+		return false;
+
+	LeaveFormation(slot);
+	freeJumping[slot] = true;
+	return true;
+}
+
+int32 FFormationSlots::FindNthInFormation(int32 n) const
+{
+	if (n < 0 || n >= numInFormation)
+		return INDEX_NONE;
+
+	// Skip whole words with a popcount, then clear the lowest set bits of the word that holds the answer
+	const uint32* words = inFormation.GetData();
+	const int32 numWords = FMath::DivideAndRoundUp(inFormation.Num(), (int32)NumBitsPerDWORD);
+	for (int32 w = 0; w < numWords; w++)
+	{
+		uint32 word = words[w];
+		int32 count = FMath::CountBits(word);
+		if (n < count)
+		{
+			for (int32 k = 0; k < n; k++)
+				word &= word - 1;
+			return w * NumBitsPerDWORD + FMath::CountTrailingZeros(word);
+		}
+		n -= count;
+	}
+	return INDEX_NONE;
+}
+
+int32 FFormationSlots::FindFrontInColumn(int32 column) const
+{
+	if (!columnCount.IsValidIndex(column) || columnCount[column] == 0)
+		return INDEX_NONE;
+
+	int32 slot = inFormation.FindFrom(true, column * rowsPerColumn);
+	return slot != INDEX_NONE && GetColumn(slot) == column ? slot : INDEX_NONE;
+}
@@ -0,0 +1,25 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "FrameTimings.h"
+
+bool FFrameTimings::bEnabled = false;
+uint64 FFrameTimings::cycles[(int32)EFrameSection::Num] = {};
+
+void FFrameTimings::Reset()
+{
+	FMemory::Memzero(cycles, sizeof(cycles));
+}
+
+double FFrameTimings::GetMilliseconds(EFrameSection section)
+{
+	return FPlatformTime::ToMilliseconds64(cycles[(int32)section]);
+}
+
+const TCHAR* FFrameTimings::GetName(EFrameSection section)
+{
+	static const TCHAR* names[(int32)EFrameSection::Num] = {
+		TEXT("squad"), TEXT("invaders"), TEXT("movement"), TEXT("bullets"), TEXT("hitTests")
+	};
+	return names[(int32)section];
+}
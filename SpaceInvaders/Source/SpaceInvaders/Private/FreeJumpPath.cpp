@@ -0,0 +1,69 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "FreeJumpPath.h"
+#include "SpaceInvaders.h"
+
+const FFreeJumpPoses& FFreeJumpPoses::Get(int32 numberOfTargetPoints)
+{
+	static TMap<int32, TUniquePtr<FFreeJumpPoses>> cache;
+	check(IsInGameThread());
+
+	TUniquePtr<FFreeJumpPoses>& poses = cache.FindOrAdd(FMath::Max(numberOfTargetPoints, 0));
+	if (!poses)
+	{
+		SI_SCOPE_CYCLE_COUNTER(STAT_SI_FreeJumpPoses);
+		poses = MakeUnique<FFreeJumpPoses>();
+		poses->offsets.Reserve(numberOfTargetPoints);
+		poses->rotations.Reserve(numberOfTargetPoints);
+
+		// A circle whose center is one radius in +X from the start location
+		float deltaTheta = 2 * PI / FMath::Max(numberOfTargetPoints, 1);
+		for (int32 i = 0; i < numberOfTargetPoints; i++)
+		{
+			float theta = i * deltaTheta; // Ángulo a avanzar en cada punto de referencia.
+			poses->offsets.Add(FVector(1.0f - FMath::Cos(theta), FMath::Sin(theta), 0.0f));
+
+			// The invader follows the tangent of the circle (FRotator in degrees, rotation in Yaw),
+			// the last point gives it back its initial rotation
+			if (i != (numberOfTargetPoints - 1))
+				poses->rotations.Add(FRotator(0.0f, -FMath::RadiansToDegrees(theta) - 90.0f, 0.0f).Quaternion());
+			else
+				poses->rotations.Add(FQuat::Identity);
+		}
+	}
+	return *poses;
+}
+
+FTransform FFreeJumpPoses::GetTargetPoint(const FTransform& origin, float radius, int32 index) const
+{
+	if (!offsets.IsValidIndex(index))
+		return origin;
+
+	FTransform target = origin;
+	target.SetLocation(origin.GetLocation() + radius * offsets[index]);
+	target.SetRotation(rotations[index] * origin.GetRotation());
+	return target;
+}
+
+FTransform FFreeJumpPoses::Evaluate(const FTransform& origin, float radius, float targetPointTime, float time) const
+{
+	if (Num() == 0)
+		return origin;
+
+	// Segment i goes from reference pose i - 1 (the start transform for the first one) to reference pose i
+	float segments = time / FMath::Max(targetPointTime, UE_KINDA_SMALL_NUMBER);
+	int32 segment = FMath::FloorToInt32(segments);
+	if (segment >= Num())
+		return GetTargetPoint(origin, radius, Num() - 1);
+
+	float fraction = segments - segment;
+	FTransform from = segment > 0 ? GetTargetPoint(origin, radius, segment - 1) : origin;
+	FTransform to = GetTargetPoint(origin, radius, segment);
+
+	FTransform newTransform = from;
+	newTransform.SetLocation(FMath::Lerp(from.GetLocation(), to.GetLocation(), fraction));
+	// Spherical interpolation for quaterions
+	newTransform.SetRotation(FQuat::Slerp(from.GetRotation(), to.GetRotation(), fraction));
+	return newTransform;
+}
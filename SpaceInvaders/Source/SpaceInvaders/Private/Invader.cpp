@@ -3,13 +3,19 @@
 
 #include "Invader.h"
 #include "Bullet.h"
+#include "BulletManager.h"
+#include "AudioVoiceManager.h"
+#include "EffectManager.h"
 #include "InvaderMovementComponent.h"
 #include "SIGameModeBase.h"
-
-#include "NiagaraFunctionLibrary.h"
+#include "FrameTimings.h"
+#include "SpaceInvaders.h"
 
 #include "Kismet/GameplayStatics.h"
-#include "Components/AudioComponent.h"
+#include "Engine/AssetManager.h"
+#include "Engine/StaticMesh.h"
+#include "NiagaraSystem.h"
+#include "Misc/PackageName.h"
 #include "Sound/SoundCue.h"
 
 // Sets default values
@@ -18,12 +24,13 @@ AInvader::AInvader()
 	  , bulletVelocity{3000.0f}
 	  , bulletClass{ABullet::StaticClass()}
 	  , positionInSquad{}
-	  , timeFromLastShot{}
-	  , leftSideTag{FName(AInvader::leftSideTagString)}
-	  , rightSideTag{FName(AInvader::rightSideTagString)}
-	  , downSideTag{FName(AInvader::downSideTagString)}
+	  , squadId{INDEX_NONE}
 	  , bFrozen{false}
 	  , bPause{false}
+	  , bDrivenBySquad{false}
+	  , baseFireRate{0.0f}
+	  , bInPool{false}
+	  , meshIndex{INDEX_NONE}
 {
 	// Set this actor to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
 	PrimaryActorTick.bCanEverTick = true;
@@ -33,31 +40,48 @@ AInvader::AInvader()
 
 	Mesh = CreateDefaultSubobject<UStaticMeshComponent>("BaseMeshComponent");
 	RootComponent = Mesh; // We need a RootComponent to have a base transform
+	Mesh->SetCollisionEnabled(ECollisionEnabled::NoCollision); // Hits are tested by the UBulletManager
+	Mesh->SetGenerateOverlapEvents(false);
 
 	// SetInvaderMesh();
 
-	// Audio component
-	AudioComponent = CreateDefaultSubobject<UAudioComponent>("Audio");
-	AudioComponent->AttachToComponent(RootComponent, FAttachmentTransformRules::KeepWorldTransform);
-
 	Movement = CreateDefaultSubobject<UInvaderMovementComponent>("InvaderMoveComponent");
 	AddOwnedComponent(Movement);
 	// Because UInvaderMovementComponent is only an Actor Component and not a Scene Component can't Attach To.
 }
 
+void AInvader::GetAssetsToPreload(TArray<FSoftObjectPath>& assets) const
+{
+	for (const TSoftObjectPtr<UStaticMesh>& invaderMesh : InvaderMeshes)
+		assets.AddUnique(invaderMesh.ToSoftObjectPath());
+	assets.AddUnique(AudioShoot.ToSoftObjectPath());
+	assets.AddUnique(AudioExplosion.ToSoftObjectPath());
+	assets.AddUnique(AudioJet.ToSoftObjectPath());
+	assets.AddUnique(ExplosionEffect.ToSoftObjectPath());
+	assets.Remove(FSoftObjectPath()); // Unset references
+}
+
 void AInvader::SetInvaderMesh(UStaticMesh* newStaticMesh, const FString path, FVector scale)
 {
-	const TCHAR* tpath;
-	tpath = AInvader::defaultStaticMeshName; // default route
 	if (!Mesh) // No Mesh component
 		return;
 
 	if (!newStaticMesh)
 	{
-		if (!path.IsEmpty())
-			tpath = *path;
-		auto MeshAsset = ConstructorHelpers::FObjectFinder<UStaticMesh>(tpath);
-		newStaticMesh = MeshAsset.Object;
+		// ConstructorHelpers can only load in constructors: here the mesh is taken from memory or streamed in
+		FSoftObjectPath meshPath(FPackageName::ExportTextPathToObjectPath(
+			path.IsEmpty() ? FString(AInvader::defaultStaticMeshName) : path));
+		newStaticMesh = Cast<UStaticMesh>(meshPath.ResolveObject());
+		if (!newStaticMesh)
+		{
+			UAssetManager::GetStreamableManager().RequestAsyncLoad(
+				meshPath, FStreamableDelegate::CreateWeakLambda(this, [this, meshPath]()
+				{
+					if (UStaticMesh* loadedMesh = Cast<UStaticMesh>(meshPath.ResolveObject()))
+						SetInvaderMesh(loadedMesh);
+				}));
+			return;
+		}
 	}
 	if (newStaticMesh)
 	{
@@ -74,118 +98,178 @@ void AInvader::BeginPlay()
 {
 	Super::BeginPlay();
 
-	SetInvaderMesh(InvaderMeshes[FMath::RandRange(0, InvaderMeshes.Num() - 1)]);
-	
-	// Generate a Bullet Template of the correct class
-	if (bulletClass->IsChildOf<ABullet>())
-		bulletTemplate = NewObject<ABullet>(this, bulletClass->GetFName(), RF_NoFlags, bulletClass.GetDefaultObject());
+	baseFireRate = fireRate;
+	ChooseMesh();
+
+	// Blueprints may have saved the old overlap settings
+	Mesh->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	Mesh->SetGenerateOverlapEvents(false);
+
+	UWorld* TheWorld = GetWorld();
+	if (TheWorld)
+	{
+		BulletManager = TheWorld->GetSubsystem<UBulletManager>();
+		AudioManager = TheWorld->GetSubsystem<UAudioVoiceManager>();
+		EffectManager = TheWorld->GetSubsystem<UEffectManager>();
+	}
+	if (BulletManager)
+		BulletManager->RegisterInvader(this);
+}
+
+void AInvader::ChooseMesh()
+{
+	if (InvaderMeshes.Num() == 0)
+		return;
+
+	// Normally preloaded by the game mode, so the spawn does not wait for the disk
+	meshIndex = random.RandRange(0, InvaderMeshes.Num() - 1);
+	UStaticMesh* invaderMesh = InvaderMeshes[meshIndex].Get();
+	SetInvaderMesh(invaderMesh, invaderMesh ? FString() : InvaderMeshes[meshIndex].ToString());
+}
+
+void AInvader::SetRandomSeed(int32 seed)
+{
+	random.Initialize(seed);
+}
+
+void AInvader::OnAcquired(const FVector& location, const FRotator& rotation)
+{
+	SetActorLocationAndRotation(location, rotation, false, nullptr, ETeleportType::ResetPhysics);
+	bInPool = false;
+	bFrozen = false;
+	bDrivenBySquad = false;
+	fireRate = baseFireRate;
+	if (Movement)
+	{
+		Movement->ResetMovement();
+		Movement->SetComponentTickEnabled(true);
+	}
+	SetActorTickEnabled(true);
+
+	SetActorHiddenInGame(false);
+	Mesh->SetVisibility(true);
+	Mesh->SetHiddenInGame(false);
+	ChooseMesh();
+
+	if (BulletManager)
+		BulletManager->RegisterInvader(this);
+}
+
+void AInvader::OnReleased()
+{
+	bInPool = true;
+	GetWorldTimerManager().ClearTimer(timerHandle);
+	DetachFromActor(FDetachmentTransformRules::KeepWorldTransform);
+	bFrozen = true; // Neither fires nor can be hit
+	SetActorHiddenInGame(true);
+	SetActorTickEnabled(false);
+	if (Movement)
+	{
+		Movement->ResetMovement();
+		Movement->SetComponentTickEnabled(false);
+	}
+
+	if (BulletManager)
+		BulletManager->UnregisterInvader(this);
+}
+
+bool AInvader::IsInPool() const
+{
+	return bInPool;
+}
+
+void AInvader::Remove()
+{
+	ASIGameModeBase* MyGameMode = Cast<ASIGameModeBase>(UGameplayStatics::GetGameMode(this));
+	if (MyGameMode)
+		MyGameMode->ReleaseInvader(this);
 	else
-		bulletTemplate = NewObject<ABullet>();
+		Destroy();
+}
+
+void AInvader::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (BulletManager)
+		BulletManager->UnregisterInvader(this);
 
-	bulletTemplate->bulletType = BulletType::INVADER;
+	Super::EndPlay(EndPlayReason);
 }
 
 // Called every frame
 void AInvader::Tick(float DeltaTime)
 {
 	Super::Tick(DeltaTime);
+	SI_SCOPE_CYCLE_COUNTER(STAT_SI_InvaderTick);
+	FScopedFrameSection section(EFrameSection::Invaders);
 
 	if (bFrozen)
 	{
 		//Frozing the invader when is shooted down
 		Movement->state = InvaderMovementType::STOP;
-		return;
 	}
-
-	this->timeFromLastShot += DeltaTime;
-
-	// Fire?
-	float val = FMath::RandRange(0.0f, 1.0f);
-	if (!bFrozen && val < (1.0 - FMath::Exp(-fireRate * this->timeFromLastShot)))
-		Fire();
 }
 
 void AInvader::Fire()
 {
+	SI_SCOPE_CYCLE_COUNTER(STAT_SI_InvaderFire);
 	FVector spawnLocation = GetActorLocation();
 	FRotator spawnRotation = GetActorRotation();
-	ABullet* spawnedBullet;
-	if (this->bulletTemplate)
+	if (this->BulletManager)
 	{
-		this->bulletTemplate->velocity = bulletVelocity;
-		this->bulletTemplate->dir = GetActorForwardVector();
-		FActorSpawnParameters spawnParameters;
-		spawnParameters.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
-		spawnParameters.Template = this->bulletTemplate;
-		spawnedBullet = (ABullet*)GetWorld()->SpawnActor<ABullet>(spawnLocation, spawnRotation, spawnParameters);
-
-		if (AudioComponent != nullptr && AudioShoot != nullptr)
-		{
-			AudioComponent->SetSound(AudioShoot);
-			AudioComponent->Play();
-		}
+		BulletManager->FireBullet(bulletClass, BulletType::INVADER, spawnLocation, spawnRotation,
+		                          GetActorForwardVector(), bulletVelocity);
 
-		this->timeFromLastShot = 0.0f;
+		if (AudioManager)
+			AudioManager->PlaySound(AudioShoot.Get(), spawnLocation, UAudioVoiceManager::invaderPriority);
 	}
 }
 
-void AInvader::NotifyActorBeginOverlap(AActor* OtherActor)
+void AInvader::HitByBullet()
 {
-	// Debug
-	//GEngine->AddOnScreenDebugMessage(-1, 1, FColor::Blue, FString::Printf(TEXT("%s entered me"), *(OtherActor->GetName())));
-	FName actorTag;
 	if (bFrozen) // If it is already a zombie invader nothing happens.
 		return;
 
-	UWorld* TheWorld = GetWorld();
-	if (TheWorld != nullptr)
-	{
-		UInvaderMovementComponent* imc = (UInvaderMovementComponent*)this->GetComponentByClass(
-			UInvaderMovementComponent::StaticClass());
-		bool bFreeJump = imc->state == InvaderMovementType::FREEJUMP;
-		AGameModeBase* GameMode = UGameplayStatics::GetGameMode(TheWorld);
-		ASIGameModeBase* MyGameMode = Cast<ASIGameModeBase>(GameMode);
-		UClass* otherActorClass = OtherActor->GetClass();
-
-		//First, bullet cases
-		if (OtherActor->IsA(ABullet::StaticClass()))
-		{
-			ABullet* bullet = Cast<ABullet>(OtherActor);
-			if (bullet->bulletType == BulletType::PLAYER)
-			{
-				//GEngine->AddOnScreenDebugMessage(-1, 1, FColor::Red, FString::Printf(TEXT("Invader %d killed"), this->positionInSquad));
-
-				OtherActor->Destroy();
-				MyGameMode->InvaderDestroyed.Broadcast(this->positionInSquad);
-				InvaderDestroyed();
-				return;
-			}
-			else
-				return; //It's an invader bullet, so it has to be ignored
-		}
+	ASIGameModeBase* MyGameMode = Cast<ASIGameModeBase>(UGameplayStatics::GetGameMode(this));
+	if (MyGameMode)
+		MyGameMode->QueueEvent(EGameplayEvent::InvaderDestroyed, this->positionInSquad, this->squadId);
+	InvaderDestroyed();
+}
 
-		// OVerlap with other Invader is ignored
-		if (OtherActor->IsA(AInvader::StaticClass()))
-			return;
+void AInvader::SilentDestroy()
+{
+	if (bFrozen)
+		return;
 
-		// Overlap with anything in freejump (except invaders and their own bullets) is a silent Destroy.
-		if (bFreeJump)
-		{
-			MyGameMode->InvaderDestroyed.Broadcast(this->positionInSquad);
-			Destroy();
-			return;
-		}
+	ASIGameModeBase* MyGameMode = Cast<ASIGameModeBase>(UGameplayStatics::GetGameMode(this));
+	if (MyGameMode)
+		MyGameMode->QueueEvent(EGameplayEvent::InvaderDestroyed, this->positionInSquad, this->squadId);
+	Remove();
+}
 
-		// Squad collides with limits
-		if (OtherActor->ActorHasTag(leftSideTag) && !bFreeJump)
-			MyGameMode->SquadOnLeftSide.ExecuteIfBound();
-		else if (OtherActor->ActorHasTag(rightSideTag) && !bFreeJump)
-			MyGameMode->SquadOnRightSide.ExecuteIfBound();
-		else if (OtherActor->ActorHasTag(downSideTag) && !bFreeJump)
-		{
-			MyGameMode->SquadSuccessful.ExecuteIfBound(); // Squad wins!
-		}
-	}
+bool AInvader::IsDying() const
+{
+	return bFrozen;
+}
+
+bool AInvader::IsFreeJumping() const
+{
+	return Movement && Movement->state == InvaderMovementType::FREEJUMP;
+}
+
+void AInvader::SetDrivenBySquad(bool bDriven)
+{
+	bDrivenBySquad = bDriven;
+	SetActorTickEnabled(!bDriven);
+	if (Movement)
+		Movement->SetComponentTickEnabled(!bDriven);
+}
+
+void AInvader::StartFreeJump()
+{
+	fireRate *= 100;
+	DetachFromActor(FDetachmentTransformRules::KeepWorldTransform); // It moves on its own from now on
+	if (Movement)
+		Movement->state = InvaderMovementType::FREEJUMP; // Moved by its squad in a batch while bDrivenBySquad
 }
 
 void AInvader::InvaderDestroyed()
@@ -197,6 +281,8 @@ void AInvader::InvaderDestroyed()
 	if (TheWorld)
 	{
 		bFrozen = true; // Invader can'tmove or fire while being destroyed
+		if (Movement)
+			Movement->state = InvaderMovementType::STOP; // Driven invaders keep their ticks off, the squad skips them
 
 		UStaticMeshComponent* LocalMeshComponent = Cast<UStaticMeshComponent>(
 			GetComponentByClass(UStaticMeshComponent::StaticClass()));
@@ -206,14 +292,11 @@ void AInvader::InvaderDestroyed()
 			LocalMeshComponent->SetVisibility(false);
 		}
 		//Audio
-		if (AudioComponent != nullptr && AudioExplosion != nullptr)
-		{
-			AudioComponent->SetSound(AudioExplosion);
-			AudioComponent->Play();
-		}
+		if (AudioManager)
+			AudioManager->PlaySound(AudioExplosion.Get(), GetActorLocation(), UAudioVoiceManager::invaderPriority);
 
-		if (ExplosionEffect)
-			UNiagaraComponent* NiagaraComp = UNiagaraFunctionLibrary::SpawnSystemAttached(ExplosionEffect, Mesh, NAME_None, FVector(0.f), FRotator(0.f), EAttachLocation::Type::KeepRelativeOffset, true);
+		if (EffectManager)
+			EffectManager->SpawnEffect(ExplosionEffect.Get(), GetActorLocation(), GetActorRotation());
 			
 		
 		// Wait:
@@ -223,7 +306,7 @@ void AInvader::InvaderDestroyed()
 
 void AInvader::PostInvaderDestroyed()
 {
-	Destroy();
+	Remove();
 }
 
 void AInvader::SetPositionInSquad(int32 index)
@@ -236,7 +319,29 @@ int32 AInvader::GetPositionInSquad()
 	return int32(this->positionInSquad);
 }
 
+void AInvader::SetSquadId(int32 id)
+{
+	this->squadId = id;
+}
+
 float AInvader::GetBoundRadius()
 {
 	return this->boundRadius;
 }
+
+float AInvader::GetMaxMeshRadius() const
+{
+	float radius = 0.0f;
+	float scale = Mesh ? Mesh->GetRelativeScale3D().GetAbsMax() : 1.0f;
+	for (const TSoftObjectPtr<UStaticMesh>& invaderMesh : InvaderMeshes)
+	{
+		if (const UStaticMesh* loadedMesh = invaderMesh.Get())
+			radius = FMath::Max(radius, loadedMesh->GetBounds().SphereRadius * scale);
+	}
+	return radius;
+}
+
+int32 AInvader::GetMeshIndex()
+{
+	return this->meshIndex;
+}
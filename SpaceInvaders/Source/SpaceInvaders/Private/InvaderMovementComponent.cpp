@@ -3,284 +3,276 @@
 
 #include "InvaderMovementComponent.h"
 #include "Invader.h"
-#include "SIGameModeBase.h"
 #include "SIPawn.h"
+#include "FreeJumpPath.h"
+#include "FrameTimings.h"
+#include "SpaceInvaders.h"
 
 #include "Kismet/GameplayStatics.h"
-#include "Kismet/KismetMathLibrary.h"
+#include "Async/ParallelFor.h"
+#include "Components/SceneComponent.h"
+#include "HAL/IConsoleManager.h"
 
-UInvaderMovementComponent::UInvaderMovementComponent()
-	: horizontalVelocity{1000.0f}
-	  , verticalVelocity{1000.0f}
-	  , state{InvaderMovementType::STOP}
-	  , descendingStep{100.0f}
-	  , numberOfTargetPoints{5}
-	  , freeJumpRadius{300.0f}
-	  , freeJumpVelocity{1000.0f}
-	  , deltaAlphaInterpolation{1.0f / 30.0f}
-	  , previousState{InvaderMovementType::STOP}
-{
-	// Set this component to be initialized when the game starts, and to be ticked every frame.  You can turn these features
-	// off to improve performance if you don't need them.
-	PrimaryComponentTick.bCanEverTick = true;
-}
-
-void UInvaderMovementComponent::BeginPlay()
-{
-	Super::BeginPlay();
-
-	UWorld* TheWorld;
+bool UInvaderMovementComponent::bScopedMovementUpdates = true;
 
-	TheWorld = GetWorld();
-	if (TheWorld)
-	{
-		AGameModeBase* GameMode = UGameplayStatics::GetGameMode(TheWorld);
-		MyGameMode = Cast<ASIGameModeBase>(GameMode);
-	}
+static FAutoConsoleVariableRef CVarScopedMovement(
+	TEXT("SI.ScopedMovement"),
+	UInvaderMovementComponent::bScopedMovementUpdates,
+	TEXT("Invaders and squads move with teleporting writes grouped under FScopedMovementUpdate (1) or with the default SetActorTransform (0)"));
 
-	finalAngle = FMath::RandRange(-30.0f, 30.0f);
-}
-
-// Generate a sequence of geometric transformation to perform a circular trajectory
-void UInvaderMovementComponent::GenerateTargetPoints()
+void FInvaderKinematics::BeginFreeJump(int32 numberOfTargetPoints)
 {
-	AActor* Parent = GetOwner();
-	FTransform initialTransform;
-	FVector initialLocation;
-	FVector initialScale;
-
-	FQuat initialQuaternion;
-	FVector forward;
-
-	if (!Parent)
-	{
-		numberOfTargetPoints = 0;
-		return;
-	}
-
-	initialTransform = Parent->GetActorTransform();
-	initialLocation = initialTransform.GetLocation();
-	initialScale = initialTransform.GetScale3D();
-	initialQuaternion = initialTransform.GetRotation();
-	forward = Parent->GetActorForwardVector();
-
-
-	// The first stage movement is a circle
-	// Calculate center of the circle from actor location
-	float radio = freeJumpRadius;
-	FVector center = initialLocation;
-
-	center.X += radio;
-
-	if (numberOfTargetPoints > 0)
-	{
-		float theta = 0.0f; // Ángulo a avanzar en cada punto de referencia.
-		float deltaTheta = 2 * PI / numberOfTargetPoints;
-
-		//GEngine->AddOnScreenDebugMessage(-1, 1, FColor::Blue, FString::Printf(TEXT("X is %g Y is %g"), initialLocation.X, initialLocation.Y));
-
-		FVector newLocation = initialLocation;
-		FRotator rotation;
-		FTransform newTransform = initialTransform;
-		for (int32 i = 0; i < numberOfTargetPoints; i++)
-		{
-			float pc = FMath::Cos(theta);
-			float ps = FMath::Sin(theta);
-
-			newLocation.X = center.X - radio * FMath::Cos(theta);
-			newLocation.Y = center.Y + radio * FMath::Sin(theta);
-			newTransform.SetLocation(newLocation);
-
-			// Change the rotation of the actor to follow the tangent of the circle
-			if (i != (numberOfTargetPoints - 1))
-			{
-				// FRotator requires angles in degrees!
-				// Rotation is in Yaw. The following angle makes the invader to follow the tangent
-				rotation = FRotator(0.0f, -(theta * 180.0f / PI) - 90, 0.0f);
-				FQuat newQuaternion = rotation.Quaternion() * initialQuaternion;
-				newTransform.SetRotation(newQuaternion);
-			}
-			else // Last point set the invader with the initial transformation
-				newTransform.SetRotation(initialQuaternion); //Last transformation 
-			targetPoints.Add(newTransform);
-			theta += deltaTheta;
-		}
-	}
+	// The reference poses are relative to the current transform
+	originTransform = transform;
+	freeJumpPoses = &FFreeJumpPoses::Get(numberOfTargetPoints);
+	freeJumpTime = 0.0f;
+	bFreeJumpAttack = false;
+	previousState = InvaderMovementType::FREEJUMP;
 }
 
-FTransform UInvaderMovementComponent::InterpolateWithTargetPoints(FTransform origin, float fraction)
+FTransform FInvaderKinematics::EvaluateFreeJump(float time) const
 {
-	FVector originLocation = origin.GetLocation();
-	FQuat originRotation = origin.GetRotation();
-	FVector targetLocation;
-	FQuat targetRotation;
-	if (currentTargetPoint >= 0 && currentTargetPoint < numberOfTargetPoints)
-	{
-		targetLocation = targetPoints[currentTargetPoint].GetLocation();
-		targetRotation = targetPoints[currentTargetPoint].GetRotation();
-	}
-	else
-		return origin;
-
-	// Location interporlation for vectors
-	FVector newLocation = UKismetMathLibrary::VLerp(originLocation, targetLocation, fraction);
-	// Spherical interpolation for quaterions
-	FQuat newRotation = FQuat::Slerp(originRotation, targetRotation, fraction);
-
-	FTransform newTransform = origin;
-	newTransform.SetLocation(newLocation);
-	newTransform.SetRotation(newRotation);
-	return newTransform;
+	return freeJumpPoses ? freeJumpPoses->Evaluate(originTransform, freeJumpRadius, targetPointTime, time) : originTransform;
 }
 
-void UInvaderMovementComponent::TickComponent(float DeltaTime, ELevelTick TickType,
-                                              FActorComponentTickFunction* ThisTickFunction)
+void FInvaderKinematics::Step(float deltaTime, const FVector& playerLocation, bool bHasPlayer)
 {
-	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
-
-	AActor* Parent = GetOwner(); //Parent is the actor who owns this component.
-
-	if (!Parent)
-		return;
-
-	float deltaHorizontal = horizontalVelocity * DeltaTime;
-
-	// Increment in horizontal and vertical dimensions given DeltaTime and parameterized velocities
-	float deltaVertical = verticalVelocity * DeltaTime;
+	bMoved = false;
 
-	// GEngine->AddOnScreenDebugMessage(-1, 1, FColor::Red, FString::Printf(TEXT("HV is %g - VV is %g - DH is %g - DV is %g"), horizontalVelocity, verticalVelocity, deltaHorizontal, deltaVertical));
+	// Increment in horizontal and vertical dimensions given deltaTime and parameterized velocities
+	float deltaHorizontal = horizontalVelocity * deltaTime;
+	float deltaVertical = verticalVelocity * deltaTime;
 
 	float deltaX = 0.0f; // These deltas determine the change of the actor position
 	float deltaY = 0.0f;
 
 	// deltaX and deltaY are calculated differently for each movement type
-	// The movement type is in the public variable state
 	// previousState is updated
 	switch (state)
 	{
 	case InvaderMovementType::STOP:
-		deltaX = 0.0f; //No variation if STOP
-		deltaY = 0.0f;
 		previousState = InvaderMovementType::STOP;
 		break;
 
 	case InvaderMovementType::RIGHT:
-
-		deltaX = 0.0f;
 		deltaY = deltaHorizontal;
-
 		previousState = InvaderMovementType::RIGHT;
 		break;
 
 	case InvaderMovementType::LEFT:
-
-		deltaX = 0.0f;
 		deltaY = -deltaHorizontal;
 		previousState = InvaderMovementType::LEFT;
 		break;
 
 	// Down movement: this is an automatic movement that has to finish automatically
-	// It is based on an internal variable, descendinfProgress, that is updated.
-
+	// It is based on an internal variable, descendingProgress, that is updated.
+	// Invaders in a squad descend with it: the squad owns the descent phase and its progress.
 	case InvaderMovementType::DOWN:
 		if (previousState != InvaderMovementType::DOWN)
 			descendingProgress = 0.0f; // This means  that the down phase is starting
 		if (descendingProgress > descendingStep)
-		{
 			deltaVertical = 0.0f; // This means that the down phase stops
-			MyGameMode->SquadFinishesDown.ExecuteIfBound();
-		}
 
 		deltaX = -deltaVertical;
-		deltaY = 0.0f;
 		descendingProgress += deltaVertical;
 		previousState = InvaderMovementType::DOWN;
 		break;
 
-	// Free jump movement: this is an automatic complex movement.
-
+	// Free jump movement: this is an automatic complex movement, not based on deltaX, deltaY.
+	// BeginFreeJump has been called on the game thread when the state started.
 	case InvaderMovementType::FREEJUMP:
-
-
-		deltaX = 0.0f; // This movement is not based on deltaX, deltaY, but in general transformations
-		deltaY = 0.0f;
-
-		if (previousState != InvaderMovementType::FREEJUMP)
 		{
-			// First time we enter in FREEJUMP
-			GenerateTargetPoints();
-			currentTargetPoint = 0;
-			if (numberOfTargetPoints > 0)
+			if (!freeJumpPoses)
+				return;
+
+			// The movement is programatically defined from the time since the jump started,
+			// so it does not depend on the frame rate. There are two stages:
+			// First stage: an automatic movement through the sequence of reference poses
+			freeJumpTime += deltaTime;
+			float attackTime = freeJumpTime - freeJumpPoses->Num() * targetPointTime; // Time spent in the second stage
+			bMoved = true;
+			if (attackTime < 0.0f)
 			{
-				originTransform = Parent->GetActorTransform();
-				// First originTransform for interpolation is actor transform
-				alphaInterpolation = 0.0f;
+				transform = EvaluateFreeJump(freeJumpTime);
+				return;
 			}
 
-			previousState = InvaderMovementType::FREEJUMP;
-		}
-
-		// Now the movement is programatically defined.
-		// There are two stages:
-		// First stage: an automatic movement defined by a sequence of target transforms
-		// currentTargetPoint is the index of the current transform
-		if (currentTargetPoint < numberOfTargetPoints)
-		{
-			FTransform newtransform = InterpolateWithTargetPoints(originTransform, alphaInterpolation);
-			// New transform calculated by interpolation between current and currentTargetPoint.
-			// The actor receive the new transform					
-			Parent->SetActorTransform(newtransform);
-
-			alphaInterpolation += deltaAlphaInterpolation;
-			if (alphaInterpolation > 1.0f)
+			// The last reference pose has been reached: aim at the player
+			if (!bFreeJumpAttack)
 			{
-				// target has been reached with interpolation
-				++currentTargetPoint;
-				alphaInterpolation = 0.0f; // To start a new segment of linear interpolation
-
+				bFreeJumpAttack = true;
+				transform = EvaluateFreeJump(freeJumpTime);
 
-				if (currentTargetPoint < numberOfTargetPoints) // new originTransform is previous target
-					originTransform = this->targetPoints[currentTargetPoint - 1];
-				// If this was the last target we get the player position in the second stage of the free jump
-				else
+				if (bHasPlayer)
 				{
-					APawn* playerPawn = UGameplayStatics::GetPlayerPawn(GetWorld(), 0);
-					if (playerPawn)
-					{
-						FVector playerLocation = playerPawn->GetActorLocation();
-						FVector invaderLocation = Parent->GetActorLocation();
-
-						// Calculate the direction from the invader to the player
-						FVector target = playerLocation - invaderLocation;
-						target.Z = 0; // Ignore the Z axis to only rotate in the horizontal plane
-						
-						FRotator TargetRotation = target.Rotation(); 
-						Parent->SetActorRotation(TargetRotation);
-					
-					}
+					// Direction from the invader to the player, only rotating in the horizontal plane
+					FVector target = playerLocation - transform.GetLocation();
+					target.Z = 0;
+					transform.SetRotation(target.Rotation().Quaternion());
 				}
+
+				// Only the part of this frame after the last reference pose is spent flying forward
+				deltaTime = FMath::Min(deltaTime, attackTime);
 			}
+
+			// Second stage: the actor is simply moved in the forward direction
+			transform.AddToTranslation(freeJumpVelocity * deltaTime * transform.GetUnitAxis(EAxis::X));
+			return;
 		}
+	}
 
-		// Second stage: the actor is simply moved in the forward direction 
+	// Invaders attached to a squad are moved with it: the squad root carries the whole formation.
+	if (!bAttached && (deltaX != 0.0f || deltaY != 0.0f))
+	{
+		transform.AddToTranslation(FVector(deltaX, deltaY, 0.0f));
+		bMoved = true;
+	}
+}
 
-		else
-		{
-			FVector parentLocation = Parent->GetActorLocation();
-			FVector forward = Parent->GetActorForwardVector();
-			// FVector right = Parent->GetActorRightVector();
-			parentLocation += freeJumpVelocity * DeltaTime * forward;
+UInvaderMovementComponent::UInvaderMovementComponent()
+	: horizontalVelocity{1000.0f}
+	  , verticalVelocity{1000.0f}
+	  , state{InvaderMovementType::STOP}
+	  , descendingStep{100.0f}
+	  , numberOfTargetPoints{5}
+	  , freeJumpRadius{300.0f}
+	  , freeJumpVelocity{1000.0f}
+	  , targetPointTime{0.5f}
+{
+	// Set this component to be initialized when the game starts, and to be ticked every frame.  You can turn these features
+	// off to improve performance if you don't need them.
+	PrimaryComponentTick.bCanEverTick = true;
+}
 
-			Parent->SetActorLocation(parentLocation);
-		}
+void UInvaderMovementComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	kinematics.finalAngle = RandomFinalAngle();
+}
+
+void UInvaderMovementComponent::ResetMovement()
+{
+	state = InvaderMovementType::STOP;
+	kinematics.previousState = InvaderMovementType::STOP;
+	kinematics.descendingProgress = 0.0f;
+	kinematics.freeJumpPoses = nullptr;
+	kinematics.freeJumpTime = 0.0f;
+	kinematics.bFreeJumpAttack = false;
+	kinematics.finalAngle = RandomFinalAngle();
+}
+
+float UInvaderMovementComponent::RandomFinalAngle() const
+{
+	// From the stream of the invader, so a seeded session always attacks with the same angles
+	const AInvader* invader = Cast<AInvader>(GetOwner());
+	return invader ? invader->GetRandom().FRandRange(-30.0f, 30.0f) : FMath::FRandRange(-30.0f, 30.0f);
+}
+
+FTransform UInvaderMovementComponent::GetTargetPoint(int32 index) const
+{
+	return kinematics.freeJumpPoses
+		       ? kinematics.freeJumpPoses->GetTargetPoint(kinematics.originTransform, freeJumpRadius, index)
+		       : kinematics.originTransform;
+}
+
+FTransform UInvaderMovementComponent::EvaluateFreeJump(float time) const
+{
+	return kinematics.EvaluateFreeJump(time);
+}
+
+void UInvaderMovementComponent::GatherKinematics()
+{
+	AActor* Parent = GetOwner(); //Parent is the actor who owns this component.
+
+	kinematics.state = state;
+	kinematics.horizontalVelocity = horizontalVelocity;
+	kinematics.verticalVelocity = verticalVelocity;
+	kinematics.descendingStep = descendingStep;
+	kinematics.freeJumpRadius = freeJumpRadius;
+	kinematics.freeJumpVelocity = freeJumpVelocity;
+	kinematics.targetPointTime = targetPointTime;
+	kinematics.bAttached = Parent->GetAttachParentActor() != nullptr;
+	kinematics.transform = Parent->GetActorTransform();
+
+	// First time we enter in FREEJUMP: the pose tables are shared, they are looked up here
+	if (state == InvaderMovementType::FREEJUMP && kinematics.previousState != InvaderMovementType::FREEJUMP)
+		kinematics.BeginFreeJump(numberOfTargetPoints);
+}
+
+void UInvaderMovementComponent::ApplyKinematics()
+{
+	if (!kinematics.bMoved)
+		return;
+
+	AActor* Parent = GetOwner();
+	if (!bScopedMovementUpdates)
+	{
+		Parent->SetActorTransform(kinematics.transform);
+		return;
 	}
 
-	// Apply calculated deltaX deltaY for those movements based on them
-	if (Parent && state != InvaderMovementType::FREEJUMP)
+	// Location and rotation in one write, no sweep and no physics velocity from the jump
+	FScopedMovementUpdate scopedMove(Parent->GetRootComponent(), EScopedUpdate::DeferredUpdates);
+	Parent->SetActorTransform(kinematics.transform, false, nullptr, ETeleportType::TeleportPhysics);
+}
+
+bool UInvaderMovementComponent::FindPlayerLocation(const UWorld* world, FVector& location)
+{
+	APawn* playerPawn = UGameplayStatics::GetPlayerPawn(world, 0);
+	if (!playerPawn)
+		return false;
+	location = playerPawn->GetActorLocation();
+	return true;
+}
+
+void UInvaderMovementComponent::MoveInvaders(TConstArrayView<UInvaderMovementComponent*> movements, float deltaTime,
+                                             TArray<FInvaderKinematics>& scratch)
+{
+	if (movements.Num() == 0)
+		return;
+	SI_SCOPE_CYCLE_COUNTER(STAT_SI_InvaderMovement);
+	FScopedFrameSection section(EFrameSection::Movement);
+
+	FVector playerLocation = FVector::ZeroVector;
+	bool bHasPlayer = FindPlayerLocation(movements[0]->GetWorld(), playerLocation);
+
+	// Gather: the actor transforms are read on the game thread
+	scratch.Reset();
+	for (UInvaderMovementComponent* movement : movements)
 	{
-		FVector parentLocation = Parent->GetActorLocation();
-		parentLocation.X += deltaX;
-		parentLocation.Y += deltaY;
-		Parent->SetActorLocation(parentLocation);
+		movement->GatherKinematics();
+		scratch.Add(movement->kinematics);
 	}
+
+	// Step: pure math on the contiguous copies
+	ParallelFor(scratch.Num(), [&scratch, deltaTime, &playerLocation, bHasPlayer](int32 i)
+	{
+		scratch[i].Step(deltaTime, playerLocation, bHasPlayer);
+	}, scratch.Num() < minParallelBatch ? EParallelForFlags::ForceSingleThread : EParallelForFlags::None);
+
+	// Apply: every moved actor is written in one pass
+	for (int32 i = 0; i < movements.Num(); i++)
+	{
+		movements[i]->kinematics = scratch[i];
+		movements[i]->ApplyKinematics();
+	}
+}
+
+void UInvaderMovementComponent::TickComponent(float DeltaTime, ELevelTick TickType,
+                                              FActorComponentTickFunction* ThisTickFunction)
+{
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+	SI_SCOPE_CYCLE_COUNTER(STAT_SI_InvaderMovement);
+	FScopedFrameSection section(EFrameSection::Movement);
+
+	if (!GetOwner())
+		return;
+
+	// The same path as a batch of one (see MoveInvaders)
+	FVector playerLocation = FVector::ZeroVector;
+	bool bHasPlayer = state == InvaderMovementType::FREEJUMP && FindPlayerLocation(GetWorld(), playerLocation);
+	GatherKinematics();
+	kinematics.Step(DeltaTime, playerLocation, bHasPlayer);
+	ApplyKinematics();
 }
@@ -0,0 +1,21 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "InvaderRoster.h"
+#include "Invader.h"
+#include "InvaderMovementComponent.h"
+
+void FInvaderRoster::Reset(int32 numColumns, int32 numRows)
+{
+	int32 capacity = numColumns * numRows;
+	invaders.Reset(capacity);
+	movements.Reset(capacity);
+	slots.Reset(numColumns, numRows);
+}
+
+int32 FInvaderRoster::Add(AInvader* invader)
+{
+	invaders.Add(invader);
+	movements.Add(invader ? invader->Movement : nullptr);
+	return slots.Add();
+}
@@ -0,0 +1,267 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "InvaderSimulation.h"
+#include "SpaceInvaders.h"
+#include "HAL/IConsoleManager.h"
+
+void FInvaderSimulation::Reset(const FInvaderSimConfig& newConfig, int32 seed)
+{
+	config = newConfig;
+	seeds.Initialize(seed);
+	input = FInvaderSimInput();
+
+	horizontalVelocity = config.horizontalVelocity;
+	verticalVelocity = config.verticalVelocity;
+	bullets = TBulletArrays<ESimFaction>();
+	hitPass.playField = config.playField;
+	hitPass.playerFaction = ESimFaction::Player;
+	hitPass.playerBulletRadius = config.bulletRadius;
+	hitPass.invaderBulletRadius = config.bulletRadius;
+
+	playerLocation = config.playerLocation;
+	playerFrozenTime = 0.0f;
+	timeFromLastPlayerShot = 0.0f;
+	points = 0;
+	lifes = config.playerLifes;
+	stepCount = 0;
+	wave = 0;
+
+	SpawnWave();
+}
+
+void FInvaderSimulation::SpawnWave()
+{
+	// The order of the seeds is the one of AInvaderSquad: free jumps when it begins play, fire once it is complete
+	rules = FSquadRules();
+	rules.random.Initialize((int32)seeds.GetUnsignedInt());
+	rules.layout.InitGrid(config.numColumns, config.numRows, config.separation, config.invaderRadius);
+	slots.Reset(config.numColumns, config.numRows);
+	for (int32 i = 0; i < config.numColumns * config.numRows; i++)
+		slots.Add();
+	squadOrigin = config.squadOrigin;
+	jumpers.SetNum(slots.Num());
+
+	rules.fireRandom.Initialize((int32)seeds.GetUnsignedInt());
+	rules.Start(slots, [this](int32 slot) { return GetSlotFireRate(slot); });
+	++wave;
+}
+
+void FInvaderSimulation::NextWave()
+{
+	points += config.pointsPerSquad;
+	horizontalVelocity += config.velocityIncreaser;
+	verticalVelocity += config.velocityIncreaser;
+	SpawnWave();
+}
+
+FVector2D FInvaderSimulation::GetInvaderLocation(int32 slot) const
+{
+	if (slots.IsInFormation(slot))
+		return squadOrigin + rules.layout.GetSlotOffset(slots, slot);
+	return FVector2D(jumpers[slot].transform.GetLocation());
+}
+
+float FInvaderSimulation::GetSlotFireRate(int32 slot) const
+{
+	return slots.IsInFormation(slot) ? config.fireRate : config.fireRate * config.freeJumpFireMultiplier;
+}
+
+void FInvaderSimulation::Step(float deltaTime)
+{
+	if (IsGameOver())
+		return;
+
+	SI_SCOPE_CYCLE_COUNTER(STAT_SI_SimulationStep);
+	++stepCount;
+	UpdatePlayer(deltaTime);
+	UpdateSquad(deltaTime);
+	UpdateInvaders(deltaTime);
+	bullets.Integrate(deltaTime);
+	ResolveHits();
+
+	// A new, faster squad replaces the destroyed one
+	if (slots.NumAlive() == 0)
+		NextWave();
+}
+
+void FInvaderSimulation::UpdatePlayer(float deltaTime)
+{
+	timeFromLastPlayerShot += deltaTime;
+	if (playerFrozenTime > 0.0f)
+	{
+		playerFrozenTime -= deltaTime;
+		return;
+	}
+
+	playerLocation.Y = FMath::Clamp(playerLocation.Y + input.move * config.playerVelocity * deltaTime,
+	                                config.playField.Min.Y + config.playerRadius,
+	                                config.playField.Max.Y - config.playerRadius);
+
+	if (input.bFire && timeFromLastPlayerShot >= config.playerFireInterval)
+	{
+		FireBullet(ESimFaction::Player, playerLocation, FVector2D(1.0f, 0.0f), config.playerBulletVelocity);
+		timeFromLastPlayerShot = 0.0f;
+	}
+}
+
+void FInvaderSimulation::UpdateSquad(float deltaTime)
+{
+	// The same step as AInvaderSquad::Decide, applied as AInvaderSquad::ApplyUpdate applies it
+	FSquadStepParams params;
+	params.horizontalVelocity = horizontalVelocity;
+	params.verticalVelocity = verticalVelocity;
+	params.descendingStep = config.descendingStep;
+	params.freeJumpRate = config.freeJumpRate;
+	FSquadStepResult step = rules.Step(slots, squadOrigin, params, config.playField, deltaTime, dueShooters);
+
+	squadOrigin += step.offset;
+	FireDueShots();
+
+	int32 slot = step.freeJump;
+	if (slot != INDEX_NONE && slots.IsInFormation(slot))
+	{
+		// It jumps from its current place, facing the player
+		FInvaderKinematics& jumper = jumpers[slot];
+		jumper = FInvaderKinematics();
+		jumper.state = InvaderMovementType::FREEJUMP;
+		jumper.freeJumpRadius = config.freeJumpRadius;
+		jumper.freeJumpVelocity = config.freeJumpVelocity;
+		jumper.targetPointTime = config.targetPointTime;
+		jumper.transform = FTransform(FRotator(0.0f, 180.0f, 0.0f), FVector(GetInvaderLocation(slot), 0.0f));
+		jumper.BeginFreeJump(config.numberOfTargetPoints);
+		slots.MarkFreeJump(slot);
+		rules.StartFreeJump(slots, slot, [this](int32 member) { return GetSlotFireRate(member); });
+	}
+
+	if (step.bLanded)
+	{
+		// Squad wins! As ASIPawn::SquadSuccessful, the player loses a life (even while exploding)
+		// and the squad is replaced.
+		--lifes;
+		playerFrozenTime = config.playerRespawnTime;
+		NextWave();
+	}
+}
+
+void FInvaderSimulation::UpdateInvaders(float deltaTime)
+{
+	// Members in formation move with squadOrigin, only the free-jumpers have their own pose
+	const FVector target(playerLocation, 0.0f);
+	for (TConstSetBitIterator<> it(slots.GetFreeJumpBits()); it; ++it)
+		jumpers[it.GetIndex()].Step(deltaTime, target, true);
+}
+
+void FInvaderSimulation::FireDueShots()
+{
+	for (int32 slot : dueShooters)
+	{
+		if (!slots.IsAlive(slot))
+			continue;
+		FVector2D forward = slots.IsInFormation(slot)
+			                    ? FVector2D(-1.0f, 0.0f) // Invaders face the player (yaw 180)
+			                    : FVector2D(jumpers[slot].transform.GetUnitAxis(EAxis::X));
+		FireBullet(ESimFaction::Invader, GetInvaderLocation(slot), forward, config.invaderBulletVelocity);
+		rules.ScheduleShot(slot, GetSlotFireRate(slot));
+	}
+}
+
+void FInvaderSimulation::FireBullet(ESimFaction faction, const FVector2D& location, const FVector2D& dir, float velocity)
+{
+	bullets.Add(FVector(location, 0.0f), FQuat::Identity, FVector(dir, 0.0f), velocity, config.bulletLifetime, faction);
+}
+
+void FInvaderSimulation::ResolveHits()
+{
+	hitPass.Begin(config.hitGridCellSize, slots.NumAlive());
+	for (TConstSetBitIterator<> it(slots.GetAliveBits()); it; ++it)
+	{
+		int32 slot = it.GetIndex();
+		hitPass.AddInvader(slot, GetInvaderLocation(slot), config.invaderRadius, !slots.IsInFormation(slot));
+	}
+
+	FHitPassPlayer player;
+	player.location = playerLocation;
+	player.radius = config.playerRadius;
+	player.bHittable = playerFrozenTime <= 0.0f;
+	hitPass.Resolve(bullets, player,
+	                [this](int32 index) { bullets.RemoveAtSwap(index); },
+	                [this](int32 slot) { return slots.IsAlive(slot); },
+	                [this](int32 slot) { KillInvader(slot); },
+	                [this]() { HitPlayer(); });
+
+	for (int32 slot : hitPass.GetLeaving())
+		KillInvader(slot);
+}
+
+void FInvaderSimulation::KillInvader(int32 slot)
+{
+	// Every destroyed invader gives points, also the ones that crash or leave the play field
+	bool bWasInFormation = slots.IsInFormation(slot);
+	if (!slots.MarkDead(slot))
+		return;
+	points += config.pointsPerInvader;
+	rules.KillMember(slots, slot, bWasInFormation, [this](int32 member) { return GetSlotFireRate(member); });
+}
+
+void FInvaderSimulation::HitPlayer()
+{
+	if (playerFrozenTime > 0.0f)
+		return;
+
+	--lifes;
+	playerFrozenTime = config.playerRespawnTime;
+}
+
+FInvaderSimConfig FInvaderSimConfig::ForSquadSize(int32 numInvaders)
+{
+	FInvaderSimConfig config;
+	config.numRows = FMath::Clamp(numInvaders, 1, 5);
+	config.numColumns = FMath::DivideAndRoundUp(FMath::Max(numInvaders, 1), config.numRows);
+	config.playField.Min.Y = FMath::Min(config.playField.Min.Y, config.squadOrigin.Y - config.separation);
+	config.playField.Max.Y = FMath::Max(config.playField.Max.Y,
+	                                    config.squadOrigin.Y + (config.numColumns + 1) * config.separation);
+	return config;
+}
+
+void FInvaderSimulation::StepAutopilot(float deltaTime)
+{
+	FInvaderSimInput autopilot;
+	autopilot.move = FMath::Sign(FMath::Sin(stepCount * deltaTime));
+	autopilot.bFire = true;
+	SetInput(autopilot);
+	Step(deltaTime);
+}
+
+// Headless run: "SI.Simulate [invaders] [seconds]" advances the simulation with a fixed 60 Hz step and the
+// autopilot, and reports the simulated steps per second. The automation test SpaceInvaders.Simulation runs it
+// without a world.
+static void RunSimulation(const TArray<FString>& Args)
+{
+	const int32 numInvaders = Args.Num() > 0 ? FMath::Max(FCString::Atoi(*Args[0]), 1) : 55;
+	const float seconds = Args.Num() > 1 ? FMath::Max(FCString::Atof(*Args[1]), 1.0f) : 600.0f;
+	const float fixedStep = 1.0f / 60.0f;
+
+	FInvaderSimConfig config = FInvaderSimConfig::ForSquadSize(numInvaders);
+	config.playerLifes = MAX_int32; // Measure the whole run
+
+	FInvaderSimulation simulation;
+	simulation.Reset(config, 1234);
+
+	const int32 numSteps = FMath::CeilToInt32(seconds / fixedStep);
+	double start = FPlatformTime::Seconds();
+	for (int32 i = 0; i < numSteps && !simulation.IsGameOver(); i++)
+		simulation.StepAutopilot(fixedStep);
+	double elapsed = FPlatformTime::Seconds() - start;
+
+	UE_LOG(LogSpaceInvaders, Display,
+	       TEXT("Simulation: %d invaders, %lld steps in %.3f s (%.0f steps/s). Wave %d, %lld points, %d bullets flying"),
+	       config.numColumns * config.numRows, simulation.GetStepCount(), elapsed,
+	       elapsed > 0.0 ? simulation.GetStepCount() / elapsed : 0.0, simulation.GetWave(), simulation.GetPoints(),
+	       simulation.NumBullets());
+}
+
+static FAutoConsoleCommand SimulateCommand(
+	TEXT("SI.Simulate"),
+	TEXT("Runs the headless game simulation with a fixed step. Usage: SI.Simulate [invaders] [seconds]"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&RunSimulation));
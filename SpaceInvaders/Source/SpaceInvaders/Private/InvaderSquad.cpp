@@ -4,25 +4,42 @@
 #include "InvaderSquad.h"
 #include "InvaderMovementComponent.h"
 #include "Invader.h"
+#include "Bullet.h"
+#include "BulletManager.h"
+#include "EffectManager.h"
 #include "SIGameModeBase.h"
+#include "FrameTimings.h"
+#include "SpaceInvaders.h"
 
 #include "Kismet/GameplayStatics.h"
+#include "Components/InstancedStaticMeshComponent.h"
+#include "NiagaraSystem.h"
 #include "Components/AudioComponent.h"
 #include "Sound/SoundCue.h"
 
 // Sets default values
 AInvaderSquad::AInvaderSquad()
-	: state{InvaderMovementType::STOP}
-	  , previousState{InvaderMovementType::STOP}
-	  , freeJumpRate{0.0001}
+	: freeJumpRate{0.0001}
 	  , horizontalVelocity{300.0}
 	  , verticalVelocity{300.0}
+	  , descendingStep{AInvaderSquad::defaultDescendingStep}
 	  , nRows{AInvaderSquad::defaultNRows}
 	  , nCols{AInvaderSquad::defaultNCols}
 	  , extraSeparation(AInvaderSquad::defaultExtraSeparation)
-	  , numberOfMembers{nRows * nCols}
+	  , bulletPoolSize{AInvaderSquad::defaultBulletPoolSize}
+	  , explosionPoolSize{AInvaderSquad::defaultExplosionPoolSize}
+	  , bDriveMemberTicks{true}
+	  , bInstancedRendering{false}
+	  , spawnBudgetMs{AInvaderSquad::defaultSpawnBudgetMs}
+	  , squadId{INDEX_NONE}
+	  , bUpdatedByGameMode{false}
+	  , nextSpawnSlot{0}
+	  , bMaterialized{false}
+	  , playField{FVector2D(-UE_BIG_NUMBER), FVector2D(UE_BIG_NUMBER)}
 {
 	PrimaryActorTick.bCanEverTick = true;
+	// Tick once the movement components have moved the invaders, so instanced rendering shows this frame's poses
+	PrimaryActorTick.TickGroup = TG_PostPhysics;
 
 	// Create Components in actor
 
@@ -34,6 +51,7 @@ AInvaderSquad::AInvaderSquad()
 void AInvaderSquad::BeginPlay()
 {
 	Super::BeginPlay();
+	startTransform = GetActorTransform();
 
 	UWorld* TheWorld = GetWorld();
 
@@ -42,10 +60,8 @@ void AInvaderSquad::BeginPlay()
 		AGameModeBase* GameMode = UGameplayStatics::GetGameMode(TheWorld);
 		MyGameMode = Cast<ASIGameModeBase>(GameMode);
 		if (MyGameMode != nullptr) {
-			MyGameMode->SquadOnRightSide.BindUObject(this, &AInvaderSquad::SquadOnRightSide);
-			MyGameMode->SquadOnLeftSide.BindUObject(this, &AInvaderSquad::SquadOnLeftSide);
-			MyGameMode->SquadFinishesDown.BindUObject(this, &AInvaderSquad::SquadFinishesDown);
-			MyGameMode->InvaderDestroyed.AddUObject(this, &AInvaderSquad::RemoveInvader);
+			MyGameMode->RegisterSquad(this); // Before the members are spawned with our id
+			rules.random.Initialize(MyGameMode->NextSeed());
 		}
 	}
 	
@@ -56,89 +72,328 @@ void AInvaderSquad::BeginPlay()
 	else
 		invaderTemplate = NewObject<AInvader>();
 
-	//Spawn Invaders
+	// Fill the invader bullet and explosion pools before the first shot
+	if (TheWorld != nullptr)
+	{
+		UBulletManager* BulletManager = TheWorld->GetSubsystem<UBulletManager>();
+		if (BulletManager)
+			BulletManager->Prewarm(invaderTemplate->bulletClass, BulletType::INVADER, bulletPoolSize);
+		UEffectManager* EffectManager = TheWorld->GetSubsystem<UEffectManager>();
+		if (EffectManager)
+			EffectManager->Prewarm(invaderTemplate->ExplosionEffect.Get(), explosionPoolSize);
+	}
+
+	if (bInstancedRendering)
+		CreateInstancedMeshes();
+
+	// Slot positions come from the mesh bounds, so they are known before any member exists
+	float radius = invaderTemplate->GetMaxMeshRadius();
+	if (radius <= 0.0f)
+		radius = AInvaderSquad::defaultMemberRadius;
+	rules.layout.InitGrid(this->nCols, this->nRows, radius * 2 + this->extraSeparation, radius);
+	Roster.Reset(this->nCols, this->nRows);
+	FindLimits();
+
+	// Members are spawned over the next frames (see SpawnMembers), the squad waits until it is complete
+	nextSpawnSlot = 0;
+	bMaterialized = false;
+	SpawnMembers();
+}
+
+void AInvaderSquad::SpawnMembers()
+{
+	SI_SCOPE_CYCLE_COUNTER(STAT_SI_SquadSpawn);
 
 	FVector actorLocation = GetActorLocation();
-	FVector spawnLocation = actorLocation;
 	FRotator spawnRotation = FRotator(0.0f, 180.0f, 0.0f);
 	// Invader Forward is oposite to Player Forward (Yaw rotation)
 	FActorSpawnParameters spawnParameters;
-	int32 count = 0;
-	AInvader* spawnedInvader;
-	float radiusX = 0.0f;
-	float radiusY = 0.0f;
-	for (int i = 0; i < this->nCols; i++)
+	spawnParameters.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+	spawnParameters.Template = invaderTemplate;
+	spawnParameters.bNoFail = true;
+
+	// At least one member per frame, then as many as fit in the budget. Recorded sessions spawn a fixed
+	// number per frame instead, so a replay materializes the squad in the same frame.
+	const int32 numSlots = this->nCols * this->nRows;
+	const double deadline = FPlatformTime::Seconds() + spawnBudgetMs / 1000.0;
+	const bool bFixedCount = MyGameMode != nullptr && MyGameMode->IsSessionRecorded();
+	const int32 lastSlot = bFixedCount
+		                       ? FMath::Min(nextSpawnSlot + AInvaderSquad::recordedSpawnsPerFrame, numSlots)
+		                       : numSlots;
+	do
 	{
-		for (int j = 0; j < this->nRows; j++)
-		{
-			//invaderTemplate->SetPositionInSquad(count);
+		// Slots are laid out column by column
+		int32 slot = nextSpawnSlot++;
+		FVector spawnLocation = actorLocation;
+		spawnLocation.X += rules.layout.rowOffsets[slot % this->nRows];
+		spawnLocation.Y += rules.layout.columnOffsets[slot / this->nRows];
 
-			spawnParameters.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
-			spawnParameters.Template = invaderTemplate;
+		// Invaders of the previous waves are reused when the game mode has any left
+		AInvader* spawnedInvader;
+		if (MyGameMode != nullptr)
+			spawnedInvader = MyGameMode->AcquireInvader(invaderTemplate, spawnLocation, spawnRotation,
+			                                            MyGameMode->NextSeed());
+		else
+		{
 			spawnedInvader = GetWorld()->SpawnActor<AInvader>(spawnLocation, spawnRotation, spawnParameters);
-			spawnedInvader->SetPositionInSquad(count);
-			++count;
-			SquadMembers.Add(spawnedInvader);
-			float r = spawnedInvader->GetBoundRadius();
-			if (r > radiusX)
-				radiusX = r;
-			if (r > radiusY)
-				radiusY = r;
-			spawnLocation.X += radiusX * 2 + this->extraSeparation;
+			INC_DWORD_STAT(STAT_SI_ActorSpawns);
 		}
-		spawnLocation.X = actorLocation.X;
-		spawnLocation.Y += radiusY * 2 + this->extraSeparation;
+		spawnedInvader->SetPositionInSquad(slot);
+		spawnedInvader->SetSquadId(squadId);
+		spawnedInvader->SetActorHiddenInGame(true); // Shown (and hittable) once the whole squad is there
+		if (bDriveMemberTicks)
+			spawnedInvader->SetDrivenBySquad(true);
+		Roster.Add(spawnedInvader);
+		// Members follow the squad root, the formation is moved as a single transform
+		spawnedInvader->AttachToComponent(Root, FAttachmentTransformRules::KeepWorldTransform);
+	}
+	while (nextSpawnSlot < lastSlot && (bFixedCount || FPlatformTime::Seconds() < deadline));
+
+	if (nextSpawnSlot >= numSlots)
+		FinishMaterializing();
+}
+
+void AInvaderSquad::FinishMaterializing()
+{
+	for (TConstSetBitIterator<> it(Roster.GetAliveBits()); it; ++it)
+	{
+		AInvader* invader = Roster.GetInvader(it.GetIndex());
+		invader->SetActorHiddenInGame(false);
+		if (bInstancedRendering)
+			AddInvaderInstance(invader, it.GetIndex());
+	}
+
+	if (MyGameMode != nullptr)
+		rules.fireRandom.Initialize(MyGameMode->NextSeed());
+	else
+		rules.fireRandom.GenerateNewSeed();
+	rules.Start(Roster.GetSlots(), [this](int32 slot) { return GetSlotFireRate(slot); });
+
+	memberState = InvaderMovementType::RIGHT;
+	bMaterialized = true;
+}
+
+bool AInvaderSquad::IsMaterialized() const
+{
+	return bMaterialized;
+}
+
+void AInvaderSquad::CreateInstancedMeshes()
+{
+	for (const TSoftObjectPtr<UStaticMesh>& mesh : invaderTemplate->InvaderMeshes)
+	{
+		// Attached to the root: instances are stored relative to the squad, so marching moves them all at once
+		UInstancedStaticMeshComponent* ism = NewObject<UInstancedStaticMeshComponent>(this);
+		ism->SetMobility(EComponentMobility::Movable);
+		ism->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+		ism->SetStaticMesh(mesh.Get()); // Preloaded by the game mode
+		ism->SetupAttachment(Root);
+		ism->RegisterComponent();
+		InstancedMeshes.Add(ism);
+	}
+	slotInstances.Init(INDEX_NONE, this->nCols * this->nRows);
+}
+
+void AInvaderSquad::AddInvaderInstance(AInvader* invader, int32 slot)
+{
+	int32 meshIndex = invader->GetMeshIndex();
+	if (!InstancedMeshes.IsValidIndex(meshIndex) || !slotInstances.IsValidIndex(slot))
+		return; // Keeps drawing its own mesh
+
+	invader->Mesh->SetHiddenInGame(true);
+	slotInstances[slot] = InstancedMeshes[meshIndex]->AddInstance(invader->GetActorTransform(), true);
+}
+
+void AInvaderSquad::HideInvaderInstance(int32 slot)
+{
+	if (!slotInstances.IsValidIndex(slot) || slotInstances[slot] == INDEX_NONE)
+		return;
+
+	UInstancedStaticMeshComponent* ism = InstancedMeshes[Roster.GetInvader(slot)->GetMeshIndex()];
+	const FTransform hidden(FQuat::Identity, FVector::ZeroVector, FVector::ZeroVector);
+	ism->UpdateInstanceTransform(slotInstances[slot], hidden, false, true);
+}
+
+void AInvaderSquad::UpdateInstanceTransforms()
+{
+	// Members in formation need no update (their instances move with the squad), only free-jumpers do
+	bool bDirty[MaxInstancedMeshes] = {};
+	for (TConstSetBitIterator<> it(Roster.GetFreeJumpBits()); it; ++it)
+	{
+		int32 slot = it.GetIndex();
+		AInvader* invader = Roster.GetInvader(slot);
+		int32 meshIndex = invader->GetMeshIndex();
+		if (slotInstances[slot] == INDEX_NONE || meshIndex >= MaxInstancedMeshes)
+			continue;
+
+		InstancedMeshes[meshIndex]->UpdateInstanceTransform(slotInstances[slot], invader->GetActorTransform(), true,
+		                                                    false);
+		bDirty[meshIndex] = true;
 	}
 
-	this->numberOfMembers = count;
-	this->state = InvaderMovementType::RIGHT; // Start with Right phase
+	// One render state update per mesh
+	for (int32 m = 0; m < InstancedMeshes.Num() && m < MaxInstancedMeshes; m++)
+	{
+		if (bDirty[m])
+			InstancedMeshes[m]->MarkRenderStateDirty();
+	}
 }
 
 void AInvaderSquad::UpdateSquadState(float delta)
 {
-	TArray<AInvader*> survivors;
+	BeginUpdate();
+	PrepareUpdate(delta);
+	ApplyUpdate();
+}
 
-	for (auto invader : SquadMembers)
+void AInvaderSquad::BeginUpdate()
+{
+	// Decisions launched while the game mode pipelined them are applied before they are decided again
+	ApplyUpdate();
+	TakeSnapshot();
+}
+
+void AInvaderSquad::PrepareUpdate(float delta)
+{
+	Decide(delta);
+}
+
+void AInvaderSquad::LaunchUpdate(float delta)
+{
+	BeginUpdate();
+	decisionTask = UE::Tasks::Launch(UE_SOURCE_LOCATION, [this, delta]
 	{
-		//------------------------------------
-		if (invader)
-		{
-			// very important, first nullptr is checked!.
-
-			// First, we get de movement component
-			UInvaderMovementComponent* imc = (UInvaderMovementComponent*)invader->GetComponentByClass(
-				UInvaderMovementComponent::StaticClass());
-
-			// Now, its state is updated
-			if (imc)
-			{
-				if (imc->state != InvaderMovementType::FREEJUMP)
-				{
-					survivors.Emplace(invader);
-					imc->horizontalVelocity = horizontalVelocity;
-					imc->verticalVelocity = verticalVelocity;
-					imc->state = state;
-				}
-			}
-		}
+		Decide(delta);
+	});
+}
+
+void AInvaderSquad::TakeSnapshot()
+{
+	snapshot.slots = Roster.GetSlots();
+	snapshot.rootLocation = FVector2D(GetActorLocation());
+	snapshot.params.horizontalVelocity = horizontalVelocity;
+	snapshot.params.verticalVelocity = verticalVelocity;
+	snapshot.params.descendingStep = descendingStep;
+	snapshot.params.freeJumpRate = freeJumpRate;
+}
 
-		//------------------------------------
+void AInvaderSquad::Decide(float delta)
+{
+	SI_SCOPE_CYCLE_COUNTER(STAT_SI_SquadUpdate);
+	decisions.step = rules.Step(snapshot.slots, snapshot.rootLocation, snapshot.params, playField, delta,
+	                            decisions.dueShooters);
+	decisions.bReady = true;
+}
+
+void AInvaderSquad::WaitForDecisions()
+{
+	if (decisionTask.IsValid() && !decisionTask.IsCompleted())
+	{
+		SI_SCOPE_CYCLE_COUNTER(STAT_SI_SquadDecisionWait);
+		decisionTask.Wait();
 	}
-	this->timeFromLastFreeJump += delta;
-	float val = FMath::RandRange(0.0f, 1.0f);
-	int32 countSurvivors = survivors.Num();
-	if (countSurvivors > 0 && val < (1.0 - FMath::Exp(-freeJumpRate * this->timeFromLastFreeJump)))
+	decisionTask = UE::Tasks::FTask();
+
+	// The scheduler is ours again: catch up with the kills
+	for (int32 slot : deferredCancels)
+		rules.fireScheduler.Cancel(slot);
+	for (int32 column : deferredColumns)
+		ScheduleColumn(column);
+	deferredCancels.Reset();
+	deferredColumns.Reset();
+}
+
+void AInvaderSquad::ApplyUpdate()
+{
+	WaitForDecisions();
+	if (!decisions.bReady)
+		return; // First frame of a pipelined squad
+	decisions.bReady = false;
+
+	SI_SCOPE_CYCLE_COUNTER(STAT_SI_SquadUpdate);
+	// Only the members still in formation follow the squad
+	for (TConstSetBitIterator<> it(Roster.GetInFormationBits()); it; ++it)
 	{
-		int32 ind = FMath::RandRange(0, countSurvivors - 1); // Randomly select one of the living invaders
-		UInvaderMovementComponent* imc = (UInvaderMovementComponent*)survivors[ind]->GetComponentByClass(
-			UInvaderMovementComponent::StaticClass());
+		UInvaderMovementComponent* imc = Roster.GetMovement(it.GetIndex());
 		if (imc)
 		{
-			//GEngine->AddOnScreenDebugMessage(-1, 1, FColor::Blue, FString::Printf(TEXT("%s on FreeJump"), *(imc->GetName())));
-			survivors[ind]->fireRate *= 100;
-			imc->state = InvaderMovementType::FREEJUMP;
+			imc->horizontalVelocity = horizontalVelocity;
+			imc->verticalVelocity = verticalVelocity;
+			imc->state = (InvaderMovementType)decisions.step.phase;
 		}
 	}
+
+	memberState = (InvaderMovementType)decisions.step.phase;
+	MoveFormation(decisions.step.offset);
+	if (decisions.step.bLanded && MyGameMode != nullptr)
+		MyGameMode->QueueEvent(EGameplayEvent::SquadSuccessful, 0, squadId); // Squad wins!
+	FireDueShots();
+
+	// Killed since the decisions picked it?
+	int32 slot = decisions.step.freeJump;
+	decisions.step.freeJump = INDEX_NONE;
+	if (slot == INDEX_NONE || !Roster.IsInFormation(slot))
+		return;
+	UInvaderMovementComponent* imc = Roster.GetMovement(slot);
+	if (imc)
+	{
+		//GEngine->AddOnScreenDebugMessage(-1, 1, FColor::Blue, FString::Printf(TEXT("%s on FreeJump"), *(imc->GetName())));
+		Roster.GetInvader(slot)->StartFreeJump();
+		Roster.MarkFreeJump(slot);
+		rules.StartFreeJump(Roster.GetSlots(), slot, [this](int32 member) { return GetSlotFireRate(member); });
+	}
+}
+
+float AInvaderSquad::GetSlotFireRate(int32 slot) const
+{
+	AInvader* invader = Roster.GetInvader(slot);
+	return IsValid(invader) ? invader->fireRate : 0.0f;
+}
+
+void AInvaderSquad::ScheduleShot(int32 slot)
+{
+	rules.ScheduleShot(slot, GetSlotFireRate(slot));
+}
+
+void AInvaderSquad::ScheduleColumn(int32 column)
+{
+	rules.ScheduleColumn(Roster.GetSlots(), column, [this](int32 slot) { return GetSlotFireRate(slot); });
+}
+
+void AInvaderSquad::FireDueShots()
+{
+	for (int32 slot : decisions.dueShooters)
+	{
+		AInvader* invader = Roster.GetInvader(slot);
+		if (!Roster.IsAlive(slot) || !IsValid(invader) || invader->IsDying())
+			continue; // Its column is scheduled again when it is removed
+		invader->Fire();
+		ScheduleShot(slot);
+	}
+}
+
+void AInvaderSquad::MoveFormation(const FVector2D& offset)
+{
+	if (offset.IsZero())
+		return;
+
+	// Hits against the formation are resolved by the bullet manager, so the root is not swept.
+	// The members attached to it are updated once, when the scope ends.
+	TOptional<FScopedMovementUpdate> scopedMove;
+	if (UInvaderMovementComponent::bScopedMovementUpdates)
+		scopedMove.Emplace(Root, EScopedUpdate::DeferredUpdates);
+	SetActorLocation(GetActorLocation() + FVector(offset, 0.0f), false, nullptr, ETeleportType::TeleportPhysics);
+}
+
+void AInvaderSquad::FindLimits()
+{
+	// The bullet manager already measured the limit volumes for its own play field tests
+	UWorld* TheWorld = GetWorld();
+	UBulletManager* BulletManager = TheWorld ? TheWorld->GetSubsystem<UBulletManager>() : nullptr;
+	if (!BulletManager)
+		return;
+
+	playField = BulletManager->GetPlayField();
 }
 
 float AInvaderSquad::GetHorizontalVelocity()
@@ -157,71 +412,152 @@ void AInvaderSquad::IncrementVelocitySquad()
 	verticalVelocity += velocityIncreaser;
 }
 
-// Called every frame
-void AInvaderSquad::Tick(float DeltaTime)
+InvaderMovementType AInvaderSquad::GetState() const
 {
-	Super::Tick(DeltaTime);
-	UpdateSquadState(DeltaTime);
+	static_assert((uint8)EMarchPhase::Right == (uint8)InvaderMovementType::RIGHT
+		&& (uint8)EMarchPhase::Left == (uint8)InvaderMovementType::LEFT
+		&& (uint8)EMarchPhase::Down == (uint8)InvaderMovementType::DOWN
+		&& (uint8)EMarchPhase::Stop == (uint8)InvaderMovementType::STOP, "March phases must match InvaderMovementType");
+	return memberState;
 }
 
-void AInvaderSquad::Destroyed()
+void AInvaderSquad::GetAssetsToPreload(TArray<FSoftObjectPath>& assets) const
+{
+	if (invaderClass && invaderClass->IsChildOf<AInvader>())
+		invaderClass->GetDefaultObject<AInvader>()->GetAssetsToPreload(assets);
+}
+
+void AInvaderSquad::SetSize(int32 rows, int32 cols)
+{
+	check(!HasActorBegunPlay());
+	nRows = FMath::Max(rows, 1);
+	nCols = FMath::Max(cols, 1);
+}
+
+void AInvaderSquad::SetSquadId(int32 id)
+{
+	squadId = id;
+}
+
+void AInvaderSquad::SetUpdatedByGameMode(bool bUpdated)
 {
-	for (AInvader* invader : SquadMembers)
+	bUpdatedByGameMode = bUpdated;
+}
+
+int32 AInvaderSquad::NumAlive() const
+{
+	return Roster.NumAlive();
+}
+
+void AInvaderSquad::SetMemberFireRate(float rate)
+{
+	WaitForDecisions();
+	for (TConstSetBitIterator<> it(Roster.GetAliveBits()); it; ++it)
 	{
-		if (invader != nullptr)
-			invader->Destroy();
+		AInvader* invader = Roster.GetInvader(it.GetIndex());
+		if (IsValid(invader))
+			invader->fireRate = rate;
+		if (rules.fireScheduler.IsScheduled(it.GetIndex()))
+			ScheduleShot(it.GetIndex()); // Resampled with the new rate
 	}
-	Super::Destroyed();
 }
 
-void AInvaderSquad::SquadOnRightSide()
+void AInvaderSquad::WidenMarchField(float margin)
 {
-	previousState = InvaderMovementType::RIGHT;
-	state = InvaderMovementType::DOWN;
+	WaitForDecisions(); // The decisions read playField
+	FBox2D bounds;
+	if (!rules.layout.GetBounds(Roster.GetSlots(), FVector2D(GetActorLocation()), bounds))
+		return;
+	playField.Min.Y = FMath::Min(playField.Min.Y, bounds.Min.Y - margin);
+	playField.Max.Y = FMath::Max(playField.Max.Y, bounds.Max.Y + margin);
 }
 
-// La escuadra llega al lado izquierdo
+// Called every frame
+void AInvaderSquad::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+	FScopedFrameSection section(EFrameSection::Squad);
+	if (!bMaterialized)
+	{
+		SpawnMembers(); // Inactive until every member is there
+		return;
+	}
+	if (!bUpdatedByGameMode)
+	{
+		UpdateSquadState(DeltaTime);
+
+		freeJumpers.Reset();
+		GetDrivenFreeJumpers(freeJumpers);
+		UInvaderMovementComponent::MoveInvaders(freeJumpers, DeltaTime, freeJumpKinematics);
+	}
+	if (bInstancedRendering)
+		UpdateInstanceTransforms();
+}
 
-void AInvaderSquad::SquadOnLeftSide()
+void AInvaderSquad::GetDrivenFreeJumpers(TArray<UInvaderMovementComponent*>& movements) const
 {
-	previousState = InvaderMovementType::LEFT;
-	state = InvaderMovementType::DOWN;
+	if (!bDriveMemberTicks)
+		return; // Their own movement components tick
+	for (TConstSetBitIterator<> it(Roster.GetFreeJumpBits()); it; ++it)
+	{
+		AInvader* invader = Roster.GetInvader(it.GetIndex());
+		UInvaderMovementComponent* imc = Roster.GetMovement(it.GetIndex());
+		if (IsValid(invader) && !invader->IsDying() && imc)
+			movements.Add(imc);
+	}
 }
 
-// Cada vez que un invasor completa el movimiento de descenso
+void AInvaderSquad::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	WaitForDecisions(); // The task reads and writes this squad
+	if (MyGameMode != nullptr)
+		MyGameMode->UnregisterSquad(this);
+	Super::EndPlay(EndPlayReason);
+}
 
-void AInvaderSquad::SquadFinishesDown()
+void AInvaderSquad::Destroyed()
 {
-	static int32 countActions = 0;
-	++countActions;
-	if (countActions >= numberOfMembers)
+	WaitForDecisions();
+	// Dead members go back to the pool themselves after their explosion
+	for (TConstSetBitIterator<> it(Roster.GetAliveBits()); it; ++it)
 	{
-		countActions = 0;
-		switch (previousState)
-		{
-		case InvaderMovementType::RIGHT:
-			state = InvaderMovementType::LEFT;
-			break;
-		case InvaderMovementType::LEFT:
-			state = InvaderMovementType::RIGHT;
-			break;
-		default:
-			state = InvaderMovementType::STOP;
-		}
+		AInvader* invader = Roster.GetInvader(it.GetIndex());
+		if (!IsValid(invader))
+			continue;
+		if (MyGameMode != nullptr)
+			MyGameMode->ReleaseInvader(invader);
+		else
+			invader->Destroy();
 	}
+	Super::Destroyed();
 }
 
+void AInvaderSquad::RemoveInvaders(TConstArrayView<int32> ids)
+{
+	for (int32 ind : ids)
+		RemoveInvader(ind);
+}
 
 void AInvaderSquad::RemoveInvader(int32 ind)
 {
-	SquadMembers[ind] = nullptr;
-	--this->numberOfMembers;
-	if (this->numberOfMembers == 0)
+	bool bWasInFormation = Roster.IsInFormation(ind);
+	if (!Roster.MarkDead(ind))
+		return;
+	if (decisionTask.IsValid())
+	{
+		// The decisions own the scheduler until the next ApplyUpdate, a due shot of this slot is skipped there
+		deferredCancels.Add(ind);
+		if (bWasInFormation)
+			deferredColumns.Add(Roster.GetSlots().GetColumn(ind));
+	}
+	else
+		rules.KillMember(Roster.GetSlots(), ind, bWasInFormation, [this](int32 slot) { return GetSlotFireRate(slot); });
+	if (bInstancedRendering)
+		HideInvaderInstance(ind);
+	if (Roster.NumAlive() == 0 && bMaterialized)
 	{
 		if (MyGameMode != nullptr)
-		{
-			MyGameMode->NewSquad.Broadcast(1); // parameter larger than 0 to avoid finishing game!
-		}
+			MyGameMode->QueueEvent(EGameplayEvent::NewSquad, 1, squadId); // parameter larger than 0 to avoid finishing game!
 	} /*else
 	{
 		horizontalVelocity += velocityIncreaser;
@@ -4,15 +4,35 @@
 #include "SIGameModeBase.h"
 
 #include "InvaderSquad.h"
+#include "Invader.h"
 #include "SIPawn.h"
 #include "SIPlayerController.h"
+#include "SessionRecorder.h"
+#include "FrameTimings.h"
+#include "SpaceInvaders.h"
 #include "Kismet/GameplayStatics.h"
+#include "Engine/AssetManager.h"
+#include "Engine/World.h"
+#include "Async/ParallelFor.h"
+#include "Algo/StableSort.h"
 
 ASIGameModeBase::ASIGameModeBase()
 	: spawnLocation{}
-	  , spawnedInvaderSquad{}
+	  , squadRows{0}
+	  , squadCols{0}
+	  , numSquads{1}
+	  , squadSpacing{1000.0f, 0.0f, 0.0f}
+	  , randomSeed{0}
+	  , bPipelinedSquadDecisions{true}
+	  , spawnedSquads{}
+	  , nextSquadId{0}
+	  , sessionSeed{0}
 
 {
+	// Updates the squads once their members have moved, like the squads did themselves
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.TickGroup = TG_PostPhysics;
+
 	DefaultPawnClass = ASIPawn::StaticClass();
 	PlayerControllerClass = ASIPlayerController::StaticClass();
 	InvaderSquadClass = AInvaderSquad::StaticClass();
@@ -24,32 +44,82 @@ void ASIGameModeBase::BeginPlay()
 {
 	Super::BeginPlay();
 
-	this->NewSquad.AddUObject(this, &ASIGameModeBase::OnNewSquad);
 	this->PlayerZeroLifes.BindUObject(this, &ASIGameModeBase::OnPlayerZeroLifes);
+	postActorTickHandle = FWorldDelegates::OnWorldPostActorTick.AddUObject(this, &ASIGameModeBase::OnWorldPostActorTick);
+
+	// Every random decision of the session comes from this seed (the recorded one when replaying)
+	sessionSeed = randomSeed != 0 ? randomSeed : FMath::Rand();
+	if (GetGameInstance())
+		Recorder = GetGameInstance()->GetSubsystem<USessionRecorder>();
+	if (Recorder)
+		sessionSeed = Recorder->BeginSession(GetWorld(), sessionSeed);
+	seedStream.Initialize(sessionSeed);
 	
-	//Spawn a squad of invaders
-	RegenerateSquad();
+	//Spawn a squad of invaders once its assets are loaded
+	PreloadSquadAssets();
+}
+
+void ASIGameModeBase::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	FWorldDelegates::OnWorldPostActorTick.Remove(postActorTickHandle);
+	queuedEvents.Empty();
+	if (Recorder)
+		Recorder->EndSession();
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void ASIGameModeBase::PreloadSquadAssets()
+{
+	TArray<FSoftObjectPath> assets;
+	if (InvaderSquadClass)
+		InvaderSquadClass->GetDefaultObject<AInvaderSquad>()->GetAssetsToPreload(assets);
+	if (assets.IsEmpty())
+	{
+		RegenerateSquad();
+		return;
+	}
+
+	// The frame an async load completes on depends on the disk, so recorded and replayed sessions would start
+	// marching on different frames: they load in place and spawn the first squad in BeginPlay
+	if (IsSessionRecorded())
+	{
+		squadAssetsHandle = UAssetManager::GetStreamableManager().RequestSyncLoad(assets);
+		RegenerateSquad();
+		return;
+	}
+
+	squadAssetsHandle = UAssetManager::GetStreamableManager().RequestAsyncLoad(
+		assets, FStreamableDelegate::CreateUObject(this, &ASIGameModeBase::RegenerateSquad));
 }
 
 void ASIGameModeBase::RegenerateSquad()
+{
+	spawnedSquads.SetNum(FMath::Max(numSquads, 1));
+	for (int32 i = 0; i < spawnedSquads.Num(); i++)
+		RegenerateSquadAt(i);
+}
+
+void ASIGameModeBase::RegenerateSquadAt(int32 index)
 {	
-	if (InvaderSquadClass)
+	if (InvaderSquadClass && spawnedSquads.IsValidIndex(index))
 	{		
-		if (this->spawnedInvaderSquad == nullptr)
+		AInvaderSquad*& spawnedInvaderSquad = spawnedSquads[index];
+		if (spawnedInvaderSquad == nullptr)
 		{
 			// If no squad has been created, create one
-			AInvaderSquad* squad = Cast<AInvaderSquad>(InvaderSquadClass->GetDefaultObject());
-			this->spawnedInvaderSquad = Cast<AInvaderSquad>(GetWorld()->SpawnActor(InvaderSquadClass, &spawnLocation));
+			spawnedInvaderSquad = SpawnSquad(index);
 		} else
 		{
 			// If there is already a squad, get its velocity and destroy it 
-			float horizontalVelocity = this->spawnedInvaderSquad->GetHorizontalVelocity();
-			float verticalVelocity = this->spawnedInvaderSquad->GetVerticalVelocity();
-			this->spawnedInvaderSquad->Destroy();
+			float horizontalVelocity = spawnedInvaderSquad->GetHorizontalVelocity();
+			float verticalVelocity = spawnedInvaderSquad->GetVerticalVelocity();
+			spawnedInvaderSquad->Destroy();
 
 			// Create a new one and set its velocity based on the previous squad velocity but increased
-			AInvaderSquad* squad = Cast<AInvaderSquad>(InvaderSquadClass->GetDefaultObject());
-			this->spawnedInvaderSquad = Cast<AInvaderSquad>(GetWorld()->SpawnActor(InvaderSquadClass, &spawnLocation));
+			spawnedInvaderSquad = SpawnSquad(index);
+			if (spawnedInvaderSquad == nullptr)
+				return;
 			spawnedInvaderSquad->horizontalVelocity = horizontalVelocity;
 			spawnedInvaderSquad->verticalVelocity = verticalVelocity;
 			spawnedInvaderSquad->IncrementVelocitySquad();
@@ -57,14 +127,268 @@ void ASIGameModeBase::RegenerateSquad()
 	}
 }
 
+AInvaderSquad* ASIGameModeBase::SpawnSquad(int32 index)
+{
+	// Deferred: the size has to be set before the squad spawns its members in BeginPlay
+	FTransform spawnTransform(spawnLocation + index * squadSpacing);
+	AInvaderSquad* squad = GetWorld()->SpawnActorDeferred<AInvaderSquad>(InvaderSquadClass, spawnTransform);
+	if (squad == nullptr)
+		return nullptr;
+
+	if (squadRows > 0 && squadCols > 0)
+		squad->SetSize(squadRows, squadCols);
+	squad->SetSquadId(nextSquadId++);
+	squad->SetUpdatedByGameMode(true);
+	squad->AddTickPrerequisiteActor(this); // Its instances show the transforms moved in our tick
+	squad->FinishSpawning(spawnTransform);
+	INC_DWORD_STAT(STAT_SI_ActorSpawns);
+	return squad;
+}
+
+void ASIGameModeBase::RegenerateLevelSquad(AInvaderSquad* squad)
+{
+	// Same class, size and movement settings, with the velocity increased as for the spawned squads
+	const TSubclassOf<AInvaderSquad> squadClass = squad->GetClass();
+	const FTransform spawnTransform = squad->GetStartTransform();
+	const int32 rows = squad->GetNumRows();
+	const int32 cols = squad->GetNumCols();
+	const float horizontalVelocity = squad->GetHorizontalVelocity();
+	const float verticalVelocity = squad->GetVerticalVelocity();
+	const float velocityIncreaser = squad->velocityIncreaser;
+	const float descendingStep = squad->descendingStep;
+	const float freeJumpRate = squad->freeJumpRate;
+	squad->Destroy();
+
+	AInvaderSquad* replacement = GetWorld()->SpawnActorDeferred<AInvaderSquad>(squadClass, spawnTransform);
+	if (replacement == nullptr)
+		return;
+	replacement->SetSize(rows, cols);
+	replacement->horizontalVelocity = horizontalVelocity;
+	replacement->verticalVelocity = verticalVelocity;
+	replacement->velocityIncreaser = velocityIncreaser;
+	replacement->descendingStep = descendingStep;
+	replacement->freeJumpRate = freeJumpRate;
+	replacement->IncrementVelocitySquad();
+	replacement->FinishSpawning(spawnTransform);
+	INC_DWORD_STAT(STAT_SI_ActorSpawns);
+}
+
+AInvaderSquad* ASIGameModeBase::GetSquad() const
+{
+	return spawnedSquads.Num() > 0 ? spawnedSquads[0] : nullptr;
+}
+
+void ASIGameModeBase::RegisterSquad(AInvaderSquad* squad)
+{
+	if (squad->GetSquadId() == INDEX_NONE)
+		squad->SetSquadId(nextSquadId++);
+	registeredSquads.AddUnique(squad);
+}
+
+void ASIGameModeBase::UnregisterSquad(AInvaderSquad* squad)
+{
+	registeredSquads.RemoveSwap(squad);
+}
+
+AInvaderSquad* ASIGameModeBase::FindSquad(int32 squadId) const
+{
+	for (AInvaderSquad* squad : registeredSquads)
+		if (IsValid(squad) && squad->GetSquadId() == squadId)
+			return squad;
+	return nullptr;
+}
+
+void ASIGameModeBase::Tick(float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+
+	UpdateSquads(DeltaSeconds);
+	MoveFreeJumpers(DeltaSeconds);
+}
+
+void ASIGameModeBase::UpdateSquads(float delta)
+{
+	FScopedFrameSection section(EFrameSection::Squad);
+	updatedSquads.Reset();
+	for (AInvaderSquad* squad : spawnedSquads)
+		if (IsValid(squad) && squad->IsMaterialized())
+			updatedSquads.Add(squad);
+
+	if (bPipelinedSquadDecisions)
+	{
+		// The decisions launched last frame are applied, and the ones for the next frame run as tasks while the
+		// rest of this frame (the later ticks, the free-jumper batch, rendering) goes on. We tick in
+		// TG_PostPhysics, so physics has already run.
+		for (AInvaderSquad* squad : updatedSquads)
+			squad->ApplyUpdate();
+		for (AInvaderSquad* squad : updatedSquads)
+			squad->LaunchUpdate(delta);
+		return;
+	}
+
+	// Snapshots read the actors, so they are taken here
+	for (AInvaderSquad* squad : updatedSquads)
+		squad->BeginUpdate();
+
+	// March, limits, due shots and free-jump rolls only touch the data of their own squad
+	ParallelFor(updatedSquads.Num(), [this, delta](int32 i)
+	{
+		updatedSquads[i]->PrepareUpdate(delta);
+	}, updatedSquads.Num() < 2 ? EParallelForFlags::ForceSingleThread : EParallelForFlags::None);
+
+	// Actors (members, bullets, the squad root) are only written here
+	for (AInvaderSquad* squad : updatedSquads)
+		squad->ApplyUpdate();
+}
+
+void ASIGameModeBase::MoveFreeJumpers(float delta)
+{
+	// The free-jumpers of every squad in one batch
+	freeJumpers.Reset();
+	for (AInvaderSquad* squad : updatedSquads)
+		squad->GetDrivenFreeJumpers(freeJumpers);
+	UInvaderMovementComponent::MoveInvaders(freeJumpers, delta, freeJumpKinematics);
+}
+
+int32 ASIGameModeBase::NextSeed()
+{
+	return (int32)seedStream.GetUnsignedInt();
+}
+
+bool ASIGameModeBase::IsSessionRecorded() const
+{
+	return Recorder && Recorder->IsSessionActive();
+}
+
+AInvader* ASIGameModeBase::AcquireInvader(AInvader* invaderTemplate, const FVector& location, const FRotator& rotation,
+                                          int32 seed)
+{
+	UClass* invaderClass = invaderTemplate ? invaderTemplate->GetClass() : AInvader::StaticClass();
+	FInvaderPool* pool = invaderPools.Find(invaderClass);
+	while (pool && pool->invaders.Num() > 0)
+	{
+		AInvader* invader = pool->invaders.Pop(EAllowShrinking::No);
+		if (IsValid(invader))
+		{
+			invader->SetRandomSeed(seed);
+			invader->OnAcquired(location, rotation);
+			return invader;
+		}
+	}
+
+	FActorSpawnParameters spawnParameters;
+	spawnParameters.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+	spawnParameters.Template = invaderTemplate;
+	spawnParameters.bNoFail = true;
+	spawnParameters.bDeferConstruction = true; // Seeded before BeginPlay draws from the stream
+	INC_DWORD_STAT(STAT_SI_ActorSpawns);
+	AInvader* invader = GetWorld()->SpawnActor<AInvader>(invaderClass, location, rotation, spawnParameters);
+	invader->SetRandomSeed(seed);
+	invader->FinishSpawning(FTransform(rotation, location));
+	return invader;
+}
+
+void ASIGameModeBase::ReleaseInvader(AInvader* invader)
+{
+	if (!IsValid(invader) || invader->IsInPool())
+		return;
+
+	invader->OnReleased();
+	invaderPools.FindOrAdd(invader->GetClass()).invaders.Add(invader);
+}
+
+void ASIGameModeBase::QueueEvent(EGameplayEvent type, int32 value, int32 squad)
+{
+	queuedEvents.Add({type, value, squad});
+	INC_DWORD_STAT(STAT_SI_EventsQueued);
+}
+
+void ASIGameModeBase::OnWorldPostActorTick(UWorld* world, ELevelTick tickType, float deltaSeconds)
+{
+	if (world == GetWorld())
+		FlushEvents();
+}
+
+void ASIGameModeBase::FlushEvents()
+{
+	SI_SCOPE_CYCLE_COUNTER(STAT_SI_EventFlush);
+	for (int32 pass = 0; pass < maxFlushPasses && !queuedEvents.IsEmpty(); pass++)
+	{
+		Swap(deliveredEvents, queuedEvents);
+		queuedEvents.Reset();
+
+		destroyedBatch.Reset();
+		squadKills.Reset();
+		for (const FGameplayEvent& event : deliveredEvents)
+		{
+			if (event.type == EGameplayEvent::InvaderDestroyed)
+			{
+				destroyedBatch.Add(event.value);
+				squadKills.Add(event);
+			}
+		}
+
+		// Every squad gets its own kills, in the order they happened
+		Algo::StableSortBy(squadKills, &FGameplayEvent::squad);
+		for (int32 first = 0, last = 0; first < squadKills.Num(); first = last)
+		{
+			squadBatch.Reset();
+			for (last = first; last < squadKills.Num() && squadKills[last].squad == squadKills[first].squad; last++)
+				squadBatch.Add(squadKills[last].value);
+			if (AInvaderSquad* squad = FindSquad(squadKills[first].squad))
+			{
+				squad->RemoveInvaders(squadBatch);
+				INC_DWORD_STAT(STAT_SI_Broadcasts);
+			}
+		}
+
+		if (!destroyedBatch.IsEmpty())
+		{
+			InvadersDestroyed.Broadcast(destroyedBatch);
+			INC_DWORD_STAT(STAT_SI_Broadcasts);
+		}
+
+		for (const FGameplayEvent& event : deliveredEvents)
+		{
+			switch (event.type)
+			{
+			case EGameplayEvent::SquadSuccessful:
+				SquadSuccessful.ExecuteIfBound(event.squad);
+				break;
+			case EGameplayEvent::NewSquad:
+				NewSquad.Broadcast(event.value);
+				if (event.squad == INDEX_NONE)
+					RegenerateSquad();
+				else if (AInvaderSquad* squad = FindSquad(event.squad))
+				{
+					int32 index = spawnedSquads.Find(squad);
+					if (index != INDEX_NONE)
+						RegenerateSquadAt(index);
+					else
+						RegenerateLevelSquad(squad);
+				}
+				break;
+			case EGameplayEvent::PlayerZeroLifes:
+				PlayerZeroLifes.ExecuteIfBound();
+				break;
+			default: // Already delivered in the batch
+				continue;
+			}
+			INC_DWORD_STAT(STAT_SI_Broadcasts);
+		}
+		deliveredEvents.Reset();
+	}
+}
+
 void ASIGameModeBase::OnNewSquad(int32 lifes)
 {
 	RegenerateSquad();
 }
 
 void ASIGameModeBase::EndGame() {
-	if (this->spawnedInvaderSquad != nullptr)
-		this->spawnedInvaderSquad->Destroy();
+	for (AInvaderSquad* spawnedInvaderSquad : spawnedSquads)
+		if (spawnedInvaderSquad != nullptr)
+			spawnedInvaderSquad->Destroy();
 	
 	// GEngine->AddOnScreenDebugMessage(-1, 1, FColor::Red, FString::Printf(TEXT("Nuevo juego")));
 
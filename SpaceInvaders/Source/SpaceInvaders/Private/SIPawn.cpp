@@ -3,17 +3,21 @@
 
 #include "SIPawn.h"
 #include "Components/StaticMeshComponent.h"
+#include "Components/SphereComponent.h"
 #include "UObject/ConstructorHelpers.h"
-#include "Components/AudioComponent.h"
 #include "Engine/World.h"
 #include "Sound/SoundCue.h"
 #include "EnhancedInputComponent.h"
 #include "EnhancedInputSubsystems.h"
 #include "Bullet.h"
+#include "BulletManager.h"
+#include "AudioVoiceManager.h"
+#include "EffectManager.h"
+#include "SessionRecorder.h"
 #include "Invader.h"
 #include "SIGameModeBase.h"
-#include "NiagaraFunctionLibrary.h"
 #include "SIGameInstance.h"
+#include "SpaceInvaders.h"
 #include "Kismet/GameplayStatics.h"
 
 // Sets default values
@@ -23,6 +27,7 @@ ASIPawn::ASIPawn()
 	  playerLifes{3},
 	  velocity{1000},
 	  bulletVelocity{3000},
+	  bulletPoolSize{32},
 
 	  AudioShoot{}, //nullptr if(AudioShoot)
 	  AudioExplosion{},
@@ -35,10 +40,6 @@ ASIPawn::ASIPawn()
 	PrimaryActorTick.bCanEverTick = true;
 
 	SetStaticMesh(); // Default mesh (SetStaticMesh with no arguments)
-	
-	// Audio component
-	AudioComponent = CreateDefaultSubobject<UAudioComponent>("Audio");
-	AudioComponent->AttachToComponent(RootComponent, FAttachmentTransformRules::KeepWorldTransform);
 }
 
 // Set a static mesh.
@@ -67,22 +68,35 @@ void ASIPawn::BeginPlay()
 {
 	Super::BeginPlay();
 
-	// Generate a Bullet Template of the correct class
-	if (bulletClass->IsChildOf<ABullet>())
-		bulletTemplate = NewObject<ABullet>(this, bulletClass);
-	else
-		bulletTemplate = NewObject<ABullet>(this);
-
-	bulletTemplate->bulletType = BulletType::PLAYER;
+	// Hits are tested by the UBulletManager. The collision component still blocks against the limits.
+	if (GetCollisionComponent())
+		GetCollisionComponent()->SetGenerateOverlapEvents(false);
+	if (GetMeshComponent())
+		GetMeshComponent()->SetGenerateOverlapEvents(false);
 
 	UWorld* TheWorld = GetWorld();
+	if (GetGameInstance())
+		Recorder = GetGameInstance()->GetSubsystem<USessionRecorder>();
+
 	if (TheWorld != nullptr)
 	{
+		// Bullets are not actors, the manager reserves room for them in advance
+		BulletManager = TheWorld->GetSubsystem<UBulletManager>();
+		if (BulletManager)
+		{
+			BulletManager->Prewarm(bulletClass, BulletType::PLAYER, bulletPoolSize);
+			BulletManager->RegisterPlayer(this);
+		}
+		AudioManager = TheWorld->GetSubsystem<UAudioVoiceManager>();
+		EffectManager = TheWorld->GetSubsystem<UEffectManager>();
+		if (EffectManager)
+			EffectManager->Prewarm(ExplosionEffect, 1);
+
 		AGameModeBase* GameMode = UGameplayStatics::GetGameMode(TheWorld);
 		MyGameMode = Cast<ASIGameModeBase>(GameMode);
 		if (MyGameMode)
 		{
-			MyGameMode->InvaderDestroyed.AddUObject(this, &ASIPawn::InvaderDestroyed);
+			MyGameMode->InvadersDestroyed.AddUObject(this, &ASIPawn::InvadersDestroyed);
 			MyGameMode->SquadSuccessful.BindUObject(this, &ASIPawn::SquadSuccessful);
 			MyGameMode->NewSquad.AddUObject(this, &ASIPawn::SquadDissolved);
 		}
@@ -120,42 +134,67 @@ void ASIPawn::SetupPlayerInputComponent(UInputComponent* PlayerInputComponent)
 }
 
 void ASIPawn::OnEnhancedMove(const FInputActionValue& Value)
+{
+	if (Recorder && !Recorder->OnLiveInput(ESessionInput::Move, Value.Get<float>()))
+		return;
+	Move(Value.Get<float>());
+}
+
+void ASIPawn::OnEnhancedFire()
+{
+	if (Recorder && !Recorder->OnLiveInput(ESessionInput::Fire))
+		return;
+	Fire();
+}
+
+void ASIPawn::OnEnhancedPause()
+{
+	if (Recorder && !Recorder->OnLiveInput(ESessionInput::Pause))
+		return;
+	TogglePause();
+}
+
+void ASIPawn::ApplyRecordedInput(const FRecordedFrame& frame)
+{
+	if (frame.Has(ESessionInput::Move))
+		Move(frame.move);
+	if (frame.Has(ESessionInput::Fire))
+		Fire();
+	if (frame.Has(ESessionInput::Pause))
+		TogglePause();
+}
+
+void ASIPawn::Move(float axis)
 {
 	if (bFrozen)
 		return;
 
 	float deltaTime = GetWorld()->GetDeltaSeconds(); // Tiempo desde la ultima ejecucion del bucle del juego
 
-	float delta = velocity * Value.Get<float>() * deltaTime;
+	float delta = velocity * axis * deltaTime;
 	FVector dir = FVector(0.0f, 1.0f, 0.0f);
 
 	AddMovementInput(dir, delta);
 }
 
-void ASIPawn::OnEnhancedFire()
+void ASIPawn::Fire()
 {
 	if (bFrozen)
 		return;
 
+	if (!BulletManager)
+		return;
+
 	FVector spawnLocation = GetActorLocation();
 	FRotator spawnRotation = GetActorRotation();
-	ABullet* spawnedBullet;
-	bulletTemplate->velocity = bulletVelocity;
-	bulletTemplate->dir = GetActorForwardVector();
-	FActorSpawnParameters spawnParameters;
-	spawnParameters.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
-	spawnParameters.Template = bulletTemplate;
-	spawnedBullet = Cast<ABullet>(GetWorld()->SpawnActor(bulletClass, &spawnLocation, &spawnRotation, spawnParameters));
-
-	if (AudioComponent != nullptr && AudioShoot != nullptr)
-	{
-		AudioComponent->SetSound(AudioShoot);
-	}
+	BulletManager->FireBullet(bulletClass, BulletType::PLAYER, spawnLocation, spawnRotation,
+	                          GetActorForwardVector(), bulletVelocity);
 
-	AudioComponent->Play();
+	if (AudioManager)
+		AudioManager->PlaySound(AudioShoot, spawnLocation, UAudioVoiceManager::playerPriority);
 }
 
-void ASIPawn::OnEnhancedPause()
+void ASIPawn::TogglePause()
 {
 	bPause = !bPause;
 }
@@ -171,28 +210,15 @@ int32 ASIPawn::GetLifes()
 	return this->playerLifes;
 }
 
-void ASIPawn::NotifyActorBeginOverlap(AActor* OtherActor)
+void ASIPawn::PlayerHit()
 {
 	if (!bFrozen)
-	{
-		// Collision with an enemy bullet
-		if (OtherActor->IsA(ABullet::StaticClass()))
-		{
-			// ABullet::StaticClass() obtengo un puntero a la UCLASS en memoria de Abullet
-			ABullet* bullet = Cast<ABullet>(OtherActor);
-			if (bullet->bulletType == BulletType::INVADER)
-			{
-				OtherActor->Destroy();
-				DestroyPlayer();
-			}
-		}
-		// Collision with an invader
-		if (OtherActor->IsA(AInvader::StaticClass()))
-		{
-			OtherActor->Destroy();
-			DestroyPlayer();
-		}
-	}
+		DestroyPlayer();
+}
+
+bool ASIPawn::IsFrozen() const
+{
+	return bFrozen;
 }
 
 void ASIPawn::DestroyPlayer()
@@ -213,17 +239,11 @@ void ASIPawn::DestroyPlayer()
 			LocalMeshComponent->SetVisibility(false);
 		}
 		//Audio
-		if (AudioComponent != nullptr && AudioExplosion != nullptr)
-		{
-			AudioComponent->SetSound(AudioExplosion);
-			AudioComponent->Play();
-		}
+		if (AudioManager)
+			AudioManager->PlaySound(AudioExplosion, GetActorLocation(), UAudioVoiceManager::playerPriority);
 
-		if (ExplosionEffect)
-		{
-			UStaticMeshComponent* Mesh = Cast<UStaticMeshComponent>(GetComponentByClass(UStaticMeshComponent::StaticClass()));
-			UNiagaraComponent* NiagaraComp = UNiagaraFunctionLibrary::SpawnSystemAttached(ExplosionEffect, Mesh, NAME_None, FVector(0.f), FRotator(0.f), EAttachLocation::Type::KeepRelativeOffset, true);
-		}
+		if (EffectManager)
+			EffectManager->SpawnEffect(ExplosionEffect, GetActorLocation(), GetActorRotation());
 		
 		// Wait:
 		TheWorld->GetTimerManager().SetTimer(timerHandle, this, &ASIPawn::PostPlayerDestroyed, 3.0f, false);
@@ -242,7 +262,7 @@ void ASIPawn::PostPlayerDestroyed()
 			if (playerPoints > GameInstance->GetRecord())
 				GameInstance->UpdateRecord(playerPoints);
 			
-			MyGameMode->PlayerZeroLifes.ExecuteIfBound();
+			MyGameMode->QueueEvent(EGameplayEvent::PlayerZeroLifes);
 		}
 		return;
 	}
@@ -260,17 +280,17 @@ void ASIPawn::PostPlayerDestroyed()
 }
 
 // Delegate responses:
-void ASIPawn::InvaderDestroyed(int32 id)
+void ASIPawn::InvadersDestroyed(TConstArrayView<int32> ids)
 {
-	this->playerPoints += this->pointsPerInvader;
+	this->playerPoints += (int64)this->pointsPerInvader * ids.Num();
 }
 
 
-void ASIPawn::SquadSuccessful()
+void ASIPawn::SquadSuccessful(int32 squadId)
 {
 	DestroyPlayer();
 	if (MyGameMode)
-		MyGameMode->NewSquad.Broadcast(this->playerLifes);
+		MyGameMode->QueueEvent(EGameplayEvent::NewSquad, this->playerLifes, squadId);
 }
 
 void ASIPawn::SquadDissolved(int32 val)
@@ -0,0 +1,253 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SessionRecorder.h"
+#include "SpaceInvaders.h"
+#include "SIPawn.h"
+#include "Engine/World.h"
+#include "Kismet/GameplayStatics.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Misc/App.h"
+#include "Misc/CommandLine.h"
+#include "Serialization/MemoryWriter.h"
+#include "Serialization/MemoryReader.h"
+
+void USessionRecorder::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	FString name;
+	if (FParse::Value(FCommandLine::Get(), TEXT("SIReplay="), name))
+		StartReplay(name);
+	else if (FParse::Value(FCommandLine::Get(), TEXT("SIRecord="), name))
+		StartRecording(name);
+}
+
+void USessionRecorder::Deinitialize()
+{
+	EndSession();
+
+	Super::Deinitialize();
+}
+
+FString USessionRecorder::GetPath(const FString& name)
+{
+	return FPaths::ProjectSavedDir() / TEXT("Replays") / (name.IsEmpty() ? TEXT("Session") : name) + TEXT(".sireplay");
+}
+
+void USessionRecorder::StartRecording(const FString& name)
+{
+	EndSession();
+	mode = ESessionMode::Recording;
+	path = GetPath(name);
+	frames.Reset();
+}
+
+bool USessionRecorder::StartReplay(const FString& name)
+{
+	EndSession();
+	path = GetPath(name);
+	if (!Load())
+	{
+		UE_LOG(LogSpaceInvaders, Warning, TEXT("Session replay: can't read %s"), *path);
+		mode = ESessionMode::Off;
+		return false;
+	}
+	mode = ESessionMode::Replaying;
+	return true;
+}
+
+int32 USessionRecorder::BeginSession(UWorld* world, int32 seed)
+{
+	if (mode == ESessionMode::Off || !world)
+		return seed;
+
+	if (preActorTickHandle.IsValid())
+		FWorldDelegates::OnWorldPreActorTick.Remove(preActorTickHandle); // A level restarted without EndPlay
+	sessionWorld = world;
+	preActorTickHandle = FWorldDelegates::OnWorldPreActorTick.AddUObject(this, &USessionRecorder::OnWorldPreActorTick);
+	replayFrame = 0;
+	if (mode == ESessionMode::Recording)
+	{
+		sessionSeed = seed;
+		frames.Reset();
+		UE_LOG(LogSpaceInvaders, Display, TEXT("Session recording: seed %d to %s"), sessionSeed, *path);
+	}
+	else
+	{
+		// Every frame advances by the recorded delta time, whatever the real one is
+		FApp::SetUseFixedTimeStep(true);
+		if (frames.Num() > 0)
+			FApp::SetFixedDeltaTime(frames[0].deltaTime);
+		UE_LOG(LogSpaceInvaders, Display, TEXT("Session replay: seed %d, %d frames from %s"), sessionSeed, frames.Num(), *path);
+	}
+	return sessionSeed;
+}
+
+void USessionRecorder::EndSession()
+{
+	if (!preActorTickHandle.IsValid())
+		return;
+
+	FWorldDelegates::OnWorldPreActorTick.Remove(preActorTickHandle);
+	preActorTickHandle.Reset();
+	sessionWorld.Reset();
+
+	if (mode == ESessionMode::Recording)
+	{
+		if (Save())
+			UE_LOG(LogSpaceInvaders, Display, TEXT("Session recording: %d frames written to %s"), frames.Num(), *path);
+		mode = ESessionMode::Off;
+	}
+	else if (mode == ESessionMode::Replaying)
+		FinishReplay();
+}
+
+void USessionRecorder::FinishReplay()
+{
+	FApp::SetUseFixedTimeStep(false);
+	mode = ESessionMode::Off;
+	UE_LOG(LogSpaceInvaders, Display, TEXT("Session replay: finished after %d of %d frames"), replayFrame, frames.Num());
+
+	if (FApp::IsUnattended())
+		FPlatformMisc::RequestExit(false, TEXT("USessionRecorder"));
+}
+
+void USessionRecorder::OnWorldPreActorTick(UWorld* world, ELevelTick tickType, float deltaSeconds)
+{
+	if (world != sessionWorld.Get())
+		return;
+
+	if (mode == ESessionMode::Recording)
+	{
+		// The pawn receives its input later in this frame (see OnLiveInput)
+		frames.AddDefaulted_GetRef().deltaTime = deltaSeconds;
+		return;
+	}
+
+	if (replayFrame >= frames.Num())
+	{
+		EndSession();
+		return;
+	}
+
+	// The pawn gets the input of the frame before anything else ticks
+	ASIPawn* Pawn = Cast<ASIPawn>(UGameplayStatics::GetPlayerPawn(world, 0));
+	if (Pawn)
+		Pawn->ApplyRecordedInput(frames[replayFrame]);
+	++replayFrame;
+	if (replayFrame < frames.Num())
+		FApp::SetFixedDeltaTime(frames[replayFrame].deltaTime); // Used by the next frame
+}
+
+bool USessionRecorder::OnLiveInput(ESessionInput input, float value)
+{
+	if (!IsSessionActive())
+		return true;
+	if (mode == ESessionMode::Replaying)
+		return false;
+
+	if (mode == ESessionMode::Recording && frames.Num() > 0)
+	{
+		FRecordedFrame& frame = frames.Last();
+		frame.actions |= (uint8)input;
+		if (input == ESessionInput::Move)
+			frame.move = value;
+	}
+	return true;
+}
+
+bool USessionRecorder::Save() const
+{
+	// Header, then delta time and action bits of every frame (plus the axis value when it moved)
+	TArray<uint8> data;
+	FMemoryWriter writer(data);
+	uint32 magic = fileMagic;
+	uint8 version = fileVersion;
+	int32 seed = sessionSeed;
+	int32 numFrames = frames.Num();
+	writer << magic << version << seed << numFrames;
+	for (FRecordedFrame frame : frames)
+	{
+		writer << frame.deltaTime << frame.actions;
+		if (frame.Has(ESessionInput::Move))
+			writer << frame.move;
+	}
+	return FFileHelper::SaveArrayToFile(data, *path);
+}
+
+bool USessionRecorder::Load()
+{
+	TArray<uint8> data;
+	if (!FFileHelper::LoadFileToArray(data, *path))
+		return false;
+
+	FMemoryReader reader(data);
+	uint32 magic = 0;
+	uint8 version = 0;
+	int32 numFrames = 0;
+	reader << magic << version << sessionSeed << numFrames;
+	if (reader.IsError() || magic != fileMagic || version != fileVersion || numFrames < 0)
+		return false;
+	// A truncated or corrupt file must not allocate more frames than it can hold
+	if (numFrames > (reader.TotalSize() - reader.Tell()) / minFrameSize)
+		return false;
+
+	frames.SetNum(numFrames);
+	for (FRecordedFrame& frame : frames)
+	{
+		reader << frame.deltaTime << frame.actions;
+		if (frame.Has(ESessionInput::Move))
+			reader << frame.move;
+	}
+	return !reader.IsError();
+}
+
+static void RestartLevel(UWorld* World)
+{
+	UGameplayStatics::OpenLevel(World, FName(*UGameplayStatics::GetCurrentLevelName(World)));
+}
+
+static void RunRecord(const TArray<FString>& Args, UWorld* World)
+{
+	USessionRecorder* Recorder = World && World->GetGameInstance() ?
+		World->GetGameInstance()->GetSubsystem<USessionRecorder>() : nullptr;
+	if (!Recorder)
+		return;
+
+	Recorder->StartRecording(Args.Num() > 0 ? Args[0] : FString());
+	RestartLevel(World);
+}
+
+static void RunReplay(const TArray<FString>& Args, UWorld* World)
+{
+	USessionRecorder* Recorder = World && World->GetGameInstance() ?
+		World->GetGameInstance()->GetSubsystem<USessionRecorder>() : nullptr;
+	if (Recorder && Recorder->StartReplay(Args.Num() > 0 ? Args[0] : FString()))
+		RestartLevel(World);
+}
+
+static void RunStopRecording(const TArray<FString>& Args, UWorld* World)
+{
+	USessionRecorder* Recorder = World && World->GetGameInstance() ?
+		World->GetGameInstance()->GetSubsystem<USessionRecorder>() : nullptr;
+	if (Recorder && Recorder->GetMode() == ESessionMode::Recording)
+		Recorder->EndSession();
+}
+
+static FAutoConsoleCommandWithWorldAndArgs RecordCommand(
+	TEXT("SI.Record"),
+	TEXT("Restarts the level and records the session. Usage: SI.Record [name]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&RunRecord));
+
+static FAutoConsoleCommandWithWorldAndArgs ReplayCommand(
+	TEXT("SI.Replay"),
+	TEXT("Restarts the level and replays a recorded session. Usage: SI.Replay [name]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&RunReplay));
+
+static FAutoConsoleCommandWithWorldAndArgs StopRecordingCommand(
+	TEXT("SI.StopRecording"),
+	TEXT("Writes the session being recorded"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&RunStopRecording));
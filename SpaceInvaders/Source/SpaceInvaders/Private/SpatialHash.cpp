@@ -0,0 +1,49 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SpatialHash.h"
+
+void FSpatialHash::Reset(float newCellSize, int32 expectedEntries)
+{
+	cellSize = FMath::Max(newCellSize, 1.0f);
+	invCellSize = 1.0f / cellSize;
+	maxRadius = 0.0f;
+
+	// Twice as many buckets as entries keeps collisions between cells low
+	int32 numBuckets = FMath::RoundUpToPowerOfTwo(FMath::Max(2 * expectedEntries, 16));
+	bucketMask = numBuckets - 1;
+	bucketStart.SetNumUninitialized(numBuckets + 1, EAllowShrinking::No);
+	entries.Reset();
+}
+
+void FSpatialHash::Add(int32 id, const FVector2D& position, float radius)
+{
+	FEntry& entry = entries.AddDefaulted_GetRef();
+	entry.position = FVector2f(position);
+	entry.radius = radius;
+	entry.id = id;
+	entry.bucket = BucketOf(CellCoord(position.X), CellCoord(position.Y));
+	maxRadius = FMath::Max(maxRadius, radius);
+}
+
+void FSpatialHash::Build()
+{
+	// Counting sort: histogram, exclusive prefix sum, scatter
+	const int32 numBuckets = bucketMask + 1;
+	FMemory::Memzero(bucketStart.GetData(), bucketStart.Num() * sizeof(int32));
+	for (const FEntry& entry : entries)
+		++bucketStart[entry.bucket + 1];
+	for (int32 b = 0; b < numBuckets; b++)
+		bucketStart[b + 1] += bucketStart[b];
+
+	sorted.SetNumUninitialized(entries.Num(), EAllowShrinking::No);
+	for (const FEntry& entry : entries)
+	{
+		// bucketStart[b] is used as the write cursor of bucket b and ends up at the start of bucket b + 1...
+		sorted[bucketStart[entry.bucket]++] = entry;
+	}
+	// ...so shift it back by one bucket
+	for (int32 b = numBuckets; b > 0; b--)
+		bucketStart[b] = bucketStart[b - 1];
+	bucketStart[0] = 0;
+}
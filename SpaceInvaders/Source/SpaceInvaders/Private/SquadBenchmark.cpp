@@ -0,0 +1,272 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SquadBenchmark.h"
+#include "SpaceInvaders.h"
+#include "SIGameModeBase.h"
+#include "SIPawn.h"
+#include "InvaderSquad.h"
+#include "BulletManager.h"
+#include "InvaderMovementComponent.h"
+#include "Engine/World.h"
+#include "Kismet/GameplayStatics.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Misc/App.h"
+
+bool USquadBenchmark::Start(int32 frames, const TArray<int32>& sizes)
+{
+	ASIGameModeBase* GameMode = Cast<ASIGameModeBase>(UGameplayStatics::GetGameMode(GetWorld()));
+	if (GameMode == nullptr || IsRunning() || sizes.IsEmpty())
+	{
+		UE_LOG(LogSpaceInvaders, Warning, TEXT("Scaling benchmark: needs a running ASIGameModeBase and no other run"));
+		return false;
+	}
+
+	sweep = sizes;
+	framesPerSize = FMath::Max(frames, 1);
+	results.Reset();
+	sizeIndex = 0;
+	movementPass = 0;
+	bSavedScopedMovement = UInvaderMovementComponent::bScopedMovementUpdates;
+
+	// The player must survive the whole run, otherwise the game ends
+	ASIPawn* Pawn = Cast<ASIPawn>(UGameplayStatics::GetPlayerPawn(GetWorld(), 0));
+	if (Pawn)
+	{
+		savedPlayerLifes = Pawn->playerLifes;
+		Pawn->playerLifes = MAX_int32 / 2;
+	}
+
+	FFrameTimings::bEnabled = true;
+	StartSize();
+	return true;
+}
+
+void USquadBenchmark::StartSize()
+{
+	// Closest to a 2:1 formation (the classic one is 11 x 5)
+	const int32 numInvaders = sweep[sizeIndex];
+	const int32 rows = FMath::Clamp(FMath::RoundToInt32(FMath::Sqrt(numInvaders / 2.0f)), 1, numInvaders);
+	const int32 cols = FMath::DivideAndRoundUp(numInvaders, rows);
+
+	ASIGameModeBase* GameMode = Cast<ASIGameModeBase>(UGameplayStatics::GetGameMode(GetWorld()));
+	GameMode->squadRows = rows;
+	GameMode->squadCols = cols;
+	GameMode->RegenerateSquad(); // Waves destroyed during the run are respawned with the same size
+	PrepareSquad();
+
+	UInvaderMovementComponent::bScopedMovementUpdates = !bCompareMovementUpdates || movementPass == 1;
+
+	current = FSquadBenchmarkResult();
+	current.numInvaders = rows * cols;
+	current.bScopedMovement = UInvaderMovementComponent::bScopedMovementUpdates;
+	warmupFrames = defaultWarmupFrames;
+	UE_LOG(LogSpaceInvaders, Display, TEXT("Scaling benchmark: %d invaders (%d x %d), %s movement writes"),
+	       current.numInvaders, cols, rows, current.bScopedMovement ? TEXT("scoped") : TEXT("default"));
+}
+
+void USquadBenchmark::PrepareSquad()
+{
+	ASIGameModeBase* GameMode = Cast<ASIGameModeBase>(UGameplayStatics::GetGameMode(GetWorld()));
+	AInvaderSquad* Squad = GameMode ? GameMode->GetSquad() : nullptr;
+	if (Squad == BenchmarkSquad || !IsValid(Squad))
+		return;
+	if (!Squad->IsMaterialized())
+	{
+		warmupFrames = defaultWarmupFrames; // The measure starts once the squad is complete
+		return;
+	}
+
+	// The formation keeps marching, so the squad section holds the root move with every member attached. Large
+	// formations do not fit in the field and would land in the middle of the measure: the squad walks from side
+	// to side of a field widened to fit it, without descending.
+	BenchmarkSquad = Squad;
+	Squad->descendingStep = 0.0f;
+	Squad->WidenMarchField(marchMargin);
+	Squad->freeJumpRate = freeJumpRate;
+	Squad->SetMemberFireRate(fireRate);
+}
+
+void USquadBenchmark::FirePlayerBullet(float DeltaTime)
+{
+	timeFromLastPlayerShot += DeltaTime;
+	if (timeFromLastPlayerShot < playerFireInterval)
+		return;
+
+	ASIPawn* Pawn = Cast<ASIPawn>(UGameplayStatics::GetPlayerPawn(GetWorld(), 0));
+	UBulletManager* BulletManager = GetWorld()->GetSubsystem<UBulletManager>();
+	if (!Pawn || !BulletManager || Pawn->IsFrozen())
+		return;
+
+	timeFromLastPlayerShot = 0.0f;
+	BulletManager->FireBullet(Pawn->bulletClass, BulletType::PLAYER, Pawn->GetActorLocation(), Pawn->GetActorRotation(),
+	                          Pawn->GetActorForwardVector(), Pawn->bulletVelocity);
+}
+
+TStatId USquadBenchmark::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(USquadBenchmark, STATGROUP_Tickables);
+}
+
+bool USquadBenchmark::IsTickable() const
+{
+	return IsRunning();
+}
+
+void USquadBenchmark::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	// Subsystems tick after the actors, so the sections hold the whole frame that just ended
+	double now = FPlatformTime::Seconds();
+	if (warmupFrames > 0)
+	{
+		--warmupFrames; // Let the spawn and the first bullets settle
+	}
+	else
+	{
+		current.frames++;
+		current.frameMs += (now - lastFrameTime) * 1000.0;
+		for (int32 s = 0; s < (int32)EFrameSection::Num; s++)
+			current.sectionMs[s] += FFrameTimings::GetMilliseconds((EFrameSection)s);
+		UBulletManager* BulletManager = GetWorld()->GetSubsystem<UBulletManager>();
+		current.bulletsFlying += BulletManager ? BulletManager->GetNumBullets() : 0;
+	}
+	FFrameTimings::Reset();
+	lastFrameTime = now;
+
+	if (current.frames >= framesPerSize)
+	{
+		results.Add(current);
+		if (bCompareMovementUpdates && movementPass == 0)
+		{
+			movementPass = 1; // Same size again, with the scoped writes
+			StartSize();
+		}
+		else if (++sizeIndex < sweep.Num())
+		{
+			movementPass = 0;
+			StartSize();
+		}
+		else
+			Finish();
+		return;
+	}
+
+	PrepareSquad(); // Waves respawned during the run get the forced rates too (once complete)
+	FirePlayerBullet(DeltaTime);
+}
+
+void USquadBenchmark::Finish()
+{
+	sizeIndex = INDEX_NONE;
+	FFrameTimings::bEnabled = false;
+	UInvaderMovementComponent::bScopedMovementUpdates = bSavedScopedMovement;
+	BenchmarkSquad = nullptr;
+
+	ASIPawn* Pawn = Cast<ASIPawn>(UGameplayStatics::GetPlayerPawn(GetWorld(), 0));
+	if (Pawn)
+		Pawn->playerLifes = savedPlayerLifes;
+
+	WriteResults();
+
+	if (bExitWhenUnattended && FApp::IsUnattended())
+		FPlatformMisc::RequestExit(false, TEXT("USquadBenchmark"));
+}
+
+void USquadBenchmark::WriteResults() const
+{
+	FString csv = TEXT("invaders,frames,scopedMovement,frameMs");
+	for (int32 s = 0; s < (int32)EFrameSection::Num; s++)
+		csv += FString::Printf(TEXT(",%sMs"), FFrameTimings::GetName((EFrameSection)s));
+	csv += TEXT(",bulletsFlying\n");
+
+	FString json = FString::Printf(TEXT("{\n\t\"build\": \"%s\",\n\t\"results\": ["), FApp::GetBuildVersion());
+	for (int32 r = 0; r < results.Num(); r++)
+	{
+		const FSquadBenchmarkResult& result = results[r];
+		const double frames = FMath::Max(result.frames, 1);
+		csv += FString::Printf(TEXT("%d,%d,%d,%.4f"), result.numInvaders, result.frames, result.bScopedMovement ? 1 : 0,
+		                       result.frameMs / frames);
+		json += FString::Printf(
+			TEXT("%s\n\t\t{\"invaders\": %d, \"frames\": %d, \"scopedMovement\": %s, \"frameMs\": %.4f"),
+			r > 0 ? TEXT(",") : TEXT(""), result.numInvaders, result.frames,
+			result.bScopedMovement ? TEXT("true") : TEXT("false"), result.frameMs / frames);
+		for (int32 s = 0; s < (int32)EFrameSection::Num; s++)
+		{
+			csv += FString::Printf(TEXT(",%.4f"), result.sectionMs[s] / frames);
+			json += FString::Printf(TEXT(", \"%sMs\": %.4f"), FFrameTimings::GetName((EFrameSection)s),
+			                        result.sectionMs[s] / frames);
+		}
+		csv += FString::Printf(TEXT(",%.1f\n"), result.bulletsFlying / frames);
+		json += FString::Printf(TEXT(", \"bulletsFlying\": %.1f}"), result.bulletsFlying / frames);
+
+		UE_LOG(LogSpaceInvaders, Display, TEXT("Scaling benchmark: %5d invaders, %.3f ms/frame (squad %.3f, invaders %.3f, movement %.3f, bullets %.3f, hit tests %.3f)"),
+		       result.numInvaders, result.frameMs / frames,
+		       result.sectionMs[(int32)EFrameSection::Squad] / frames,
+		       result.sectionMs[(int32)EFrameSection::Invaders] / frames,
+		       result.sectionMs[(int32)EFrameSection::Movement] / frames,
+		       result.sectionMs[(int32)EFrameSection::Bullets] / frames,
+		       result.sectionMs[(int32)EFrameSection::HitTests] / frames);
+
+		// Runs of the same size come in pairs when the movement writes are compared
+		if (r > 0 && result.bScopedMovement && !results[r - 1].bScopedMovement
+			&& results[r - 1].numInvaders == result.numInvaders)
+			LogMovementSavings(results[r - 1], result);
+	}
+	json += TEXT("\n\t]\n}\n");
+
+	const FString path = FPaths::ProjectSavedDir() / TEXT("Benchmarks") /
+		FString::Printf(TEXT("SquadScaling_%s"), *FDateTime::Now().ToString());
+	FFileHelper::SaveStringToFile(csv, *(path + TEXT(".csv")));
+	FFileHelper::SaveStringToFile(json, *(path + TEXT(".json")));
+	UE_LOG(LogSpaceInvaders, Display, TEXT("Scaling benchmark: results written to %s.csv/.json"), *path);
+}
+
+void USquadBenchmark::LogMovementSavings(const FSquadBenchmarkResult& before, const FSquadBenchmarkResult& after)
+{
+	// Both runs write with no sweep. The scoped one teleports (no physics velocity) and defers the update of the
+	// attachments to the end of an FScopedMovementUpdate. Movement holds the single write of every free-jumper,
+	// Squad the root move of the marching formation with its members attached.
+	const double movementBefore = before.sectionMs[(int32)EFrameSection::Movement] / FMath::Max(before.frames, 1);
+	const double movementAfter = after.sectionMs[(int32)EFrameSection::Movement] / FMath::Max(after.frames, 1);
+	const double squadBefore = before.sectionMs[(int32)EFrameSection::Squad] / FMath::Max(before.frames, 1);
+	const double squadAfter = after.sectionMs[(int32)EFrameSection::Squad] / FMath::Max(after.frames, 1);
+	const double frameBefore = before.frameMs / FMath::Max(before.frames, 1);
+	const double frameAfter = after.frameMs / FMath::Max(after.frames, 1);
+	UE_LOG(LogSpaceInvaders, Display, TEXT("Scaling benchmark: %5d invaders, teleporting scoped writes vs plain SetActorTransform (both unswept) save %.3f ms of free-jumper movement (%.1f%%), %.3f ms of squad root move with its members, %.3f ms/frame"),
+	       after.numInvaders, movementBefore - movementAfter,
+	       movementBefore > 0.0 ? 100.0 * (movementBefore - movementAfter) / movementBefore : 0.0,
+	       squadBefore - squadAfter, frameBefore - frameAfter);
+}
+
+const TArray<int32> USquadBenchmark::defaultSizes = {10, 100, 1000, 5000};
+
+bool USquadBenchmark::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+static void RunScalingBenchmark(const TArray<FString>& Args, UWorld* World)
+{
+	USquadBenchmark* Benchmark = World ? World->GetSubsystem<USquadBenchmark>() : nullptr;
+	if (!Benchmark)
+		return;
+
+	const int32 frames = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : USquadBenchmark::defaultFramesPerSize;
+	TArray<int32> sizes;
+	for (int32 i = 1; i < Args.Num(); i++)
+		sizes.Add(FMath::Max(FCString::Atoi(*Args[i]), 1));
+	if (sizes.IsEmpty())
+		sizes = USquadBenchmark::defaultSizes;
+
+	Benchmark->bExitWhenUnattended = true;
+	Benchmark->Start(frames, sizes);
+}
+
+static FAutoConsoleCommandWithWorldAndArgs ScalingBenchmarkCommand(
+	TEXT("SI.ScalingBenchmark"),
+	TEXT("Measures the frame cost of growing squads. Usage: SI.ScalingBenchmark [frames] [invaders...]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&RunScalingBenchmark));
@@ -0,0 +1,32 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SquadRules.h"
+
+FSquadStepResult FSquadRules::Step(const FFormationSlots& slots, const FVector2D& rootLocation,
+                                   const FSquadStepParams& params, const FBox2D& playField, float delta,
+                                   TArray<int32>& dueShooters)
+{
+	FSquadStepResult result;
+	result.phase = march.phase; // Members in formation follow the phase the squad had at the start of the step
+
+	result.offset = march.Step(delta, params.horizontalVelocity, params.verticalVelocity, params.descendingStep);
+	FBox2D bounds;
+	if (layout.GetBounds(slots, rootLocation + result.offset, bounds))
+		result.bLanded = march.CheckLimits(bounds, playField);
+
+	fireClock += delta;
+	dueShooters.Reset();
+	for (int32 slot = fireScheduler.PopDue(fireClock); slot != INDEX_NONE; slot = fireScheduler.PopDue(fireClock))
+		dueShooters.Add(slot);
+
+	timeFromLastFreeJump += delta;
+	float val = random.FRand();
+	int32 countSurvivors = slots.NumInFormation();
+	if (countSurvivors > 0 && val < ExponentialChance(params.freeJumpRate, timeFromLastFreeJump))
+	{
+		// Randomly select one of the members in formation
+		result.freeJump = slots.FindNthInFormation(random.RandRange(0, countSurvivors - 1));
+	}
+	return result;
+}
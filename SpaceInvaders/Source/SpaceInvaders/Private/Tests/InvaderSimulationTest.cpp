@@ -0,0 +1,78 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "InvaderSimulation.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+// The simulation needs no world, so these run with no map and no GPU:
+// UnrealEditor-Cmd SpaceInvaders.uproject -nullrhi -unattended -ExecCmds="Automation RunTests SpaceInvaders.Simulation; Quit"
+
+namespace
+{
+	constexpr float simFixedStep = 1.0f / 60.0f;
+
+	// Runs the autopilot for seconds (or until the game is over) and returns the steps done
+	int32 RunAutopilot(FInvaderSimulation& simulation, float seconds)
+	{
+		const int32 numSteps = FMath::CeilToInt32(seconds / simFixedStep);
+		int32 steps = 0;
+		for (; steps < numSteps && !simulation.IsGameOver(); steps++)
+			simulation.StepAutopilot(simFixedStep);
+		return steps;
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FInvaderSimulationDeterminismTest, "SpaceInvaders.Simulation.Determinism",
+                                 EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FInvaderSimulationDeterminismTest::RunTest(const FString& Parameters)
+{
+	// Same seed and input, same game
+	const FInvaderSimConfig config = FInvaderSimConfig::ForSquadSize(55);
+	FInvaderSimulation first;
+	FInvaderSimulation second;
+	first.Reset(config, 1234);
+	second.Reset(config, 1234);
+	RunAutopilot(first, 120.0f);
+	RunAutopilot(second, 120.0f);
+
+	TestEqual(TEXT("Steps"), first.GetStepCount(), second.GetStepCount());
+	TestEqual(TEXT("Points"), first.GetPoints(), second.GetPoints());
+	TestEqual(TEXT("Lifes"), first.GetLifes(), second.GetLifes());
+	TestEqual(TEXT("Wave"), first.GetWave(), second.GetWave());
+	TestEqual(TEXT("Invaders alive"), first.NumInvadersAlive(), second.NumInvadersAlive());
+	TestEqual(TEXT("Bullets flying"), first.NumBullets(), second.NumBullets());
+	TestTrue(TEXT("Player location"), first.GetPlayerLocation().Equals(second.GetPlayerLocation(), 0.0));
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FInvaderSimulationScalingTest, "SpaceInvaders.Simulation.Scaling",
+                                 EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::PerfFilter)
+
+bool FInvaderSimulationScalingTest::RunTest(const FString& Parameters)
+{
+	// Ten simulated minutes per size, the same sizes as the squad scaling benchmark
+	for (int32 numInvaders : {55, 1000, 5000})
+	{
+		FInvaderSimConfig config = FInvaderSimConfig::ForSquadSize(numInvaders);
+		config.playerLifes = MAX_int32; // The whole run is measured
+
+		FInvaderSimulation simulation;
+		simulation.Reset(config, 1234);
+		const double start = FPlatformTime::Seconds();
+		const int32 steps = RunAutopilot(simulation, 600.0f);
+		const double elapsed = FPlatformTime::Seconds() - start;
+
+		TestEqual(FString::Printf(TEXT("Steps with %d invaders"), numInvaders), steps,
+		          FMath::CeilToInt32(600.0f / simFixedStep));
+		TestTrue(FString::Printf(TEXT("Points with %d invaders"), numInvaders), simulation.GetPoints() > 0);
+		AddInfo(FString::Printf(TEXT("%d invaders: %d steps in %.3f s (%.0f steps/s), wave %d, %lld points"),
+		                        config.numColumns * config.numRows, steps, elapsed,
+		                        elapsed > 0.0 ? steps / elapsed : 0.0, simulation.GetWave(), simulation.GetPoints()));
+	}
+	return true;
+}
+
+#endif
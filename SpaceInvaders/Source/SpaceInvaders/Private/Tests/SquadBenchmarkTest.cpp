@@ -0,0 +1,92 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SquadBenchmark.h"
+#include "Misc/AutomationTest.h"
+#include "Tests/AutomationCommon.h"
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+	UWorld* FindGameWorld()
+	{
+		for (const FWorldContext& context : GEngine->GetWorldContexts())
+		{
+			if (context.WorldType == EWorldType::Game || context.WorldType == EWorldType::PIE)
+				return context.World();
+		}
+		return nullptr;
+	}
+}
+
+// Starts the sweep on the game world once the game mode is up, then waits for it to finish
+class FSquadScalingBenchmarkCommand : public IAutomationLatentCommand
+{
+public:
+	FSquadScalingBenchmarkCommand(FAutomationTestBase* inTest, int32 inFramesPerSize, const TArray<int32>& inSizes)
+		: test{inTest}
+		  , framesPerSize{inFramesPerSize}
+		  , sizes{inSizes}
+	{
+	}
+
+	virtual bool Update() override
+	{
+		UWorld* world = FindGameWorld();
+		USquadBenchmark* benchmark = world ? world->GetSubsystem<USquadBenchmark>() : nullptr;
+		if (GetCurrentRunTime() > timeout)
+		{
+			test->AddError(TEXT("The scaling benchmark did not finish in time"));
+			return true;
+		}
+		if (!benchmark)
+			return false;
+
+		if (!bStarted)
+		{
+			bStarted = benchmark->Start(framesPerSize, sizes); // Retried until the game mode has begun play
+			return false;
+		}
+		if (benchmark->IsRunning())
+			return false;
+
+		// Every size measured, twice when the movement writes are compared
+		const int32 runsPerSize = benchmark->bCompareMovementUpdates ? 2 : 1;
+		const TArray<FSquadBenchmarkResult>& results = benchmark->GetResults();
+		test->TestEqual(TEXT("Measured runs"), results.Num(), sizes.Num() * runsPerSize);
+		for (const FSquadBenchmarkResult& result : results)
+		{
+			test->TestEqual(FString::Printf(TEXT("Frames measured with %d invaders"), result.numInvaders),
+			                result.frames, framesPerSize);
+			test->AddInfo(FString::Printf(TEXT("%d invaders (%s movement writes): %.3f ms/frame"), result.numInvaders,
+			                              result.bScopedMovement ? TEXT("scoped") : TEXT("default"),
+			                              result.frameMs / FMath::Max(result.frames, 1)));
+		}
+		return true;
+	}
+
+private:
+	FAutomationTestBase* test;
+	int32 framesPerSize;
+	TArray<int32> sizes;
+	bool bStarted = false;
+
+	static constexpr double timeout = 1800.0; // Seconds
+};
+
+// The sweep of SI.ScalingBenchmark, results also written to Saved/Benchmarks. Needs the game (-game), not PIE.
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FSquadScalingBenchmarkTest, "SpaceInvaders.Benchmark.SquadScaling",
+                                 EAutomationTestFlags::ClientContext | EAutomationTestFlags::PerfFilter)
+
+bool FSquadScalingBenchmarkTest::RunTest(const FString& Parameters)
+{
+	AutomationOpenMap(TEXT("/Game/Level/Map1"));
+	ADD_LATENT_AUTOMATION_COMMAND(FSquadScalingBenchmarkCommand(this, USquadBenchmark::defaultFramesPerSize,
+		USquadBenchmark::defaultSizes));
+	return true;
+}
+
+#endif
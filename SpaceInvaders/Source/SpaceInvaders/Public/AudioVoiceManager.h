@@ -0,0 +1,75 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "AudioVoiceManager.generated.h"
+
+// One pooled audio component and what it is playing
+USTRUCT()
+struct FAudioVoice
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	class UAudioComponent* Component = nullptr;
+
+	UPROPERTY()
+	class USoundBase* Sound = nullptr; // Last sound played, compare with IsPlaying before trusting it
+
+	int32 priority = 0;
+	double startTime = 0.0;
+};
+
+/**
+ * Plays the one-shot sounds of the game (shots and explosions) with a small pool of audio components
+ * instead of one component per actor. Concurrency: at most maxVoices at once and maxVoicesPerSound of
+ * the same sound; when full the oldest voice of the same or a lower priority is stopped, otherwise the
+ * request is culled. Sounds further than cullDistance from the listener are culled too.
+ * The limits are read from the [/Script/SpaceInvaders.AudioVoiceManager] section of DefaultGame.ini.
+ */
+UCLASS(Config=Game)
+class SPACEINVADERS_API UAudioVoiceManager : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Deinitialize() override;
+
+	// Plays sound at location. Returns false when the request is culled.
+	UFUNCTION(BlueprintCallable)
+	bool PlaySound(class USoundBase* sound, FVector location, int32 priority = 0);
+
+	UFUNCTION(BlueprintCallable)
+	int32 GetNumPlaying() const;
+
+	UPROPERTY(Config)
+	int32 maxVoices = 12;
+
+	UPROPERTY(Config)
+	int32 maxVoicesPerSound = 3;
+
+	UPROPERTY(Config)
+	float cullDistance = 0.0f; // Zero disables the distance culling
+
+	// Priorities of the requests of the game
+	static constexpr int32 invaderPriority = 0;
+	static constexpr int32 playerPriority = 1;
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	UPROPERTY()
+	TArray<FAudioVoice> voices; // Grows up to maxVoices
+
+	UPROPERTY()
+	AActor* VoicesOwner; // Hosts the audio components
+
+	class UAudioComponent* CreateVoiceComponent();
+
+	bool IsAudible(const FVector& location) const;
+
+	static bool IsPlaying(const FAudioVoice& voice);
+};
@@ -14,6 +14,10 @@ enum class BulletType : uint8
 };
 
 
+/**
+ * Bullet archetype. Bullets are not spawned as actors: UBulletManager keeps them in arrays and
+ * reads the mesh (scale and materials included) and the lifetime from the defaults of this class.
+ */
 UCLASS()
 class SPACEINVADERS_API ABullet : public AActor
 {
@@ -27,33 +31,21 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite)
 	class UStaticMeshComponent* Mesh;
 
-
-	UPROPERTY(EditAnywhere, BlueprintReadWrite)
-	FVector dir;
-
+	// Seconds a bullet flies before it is removed, if it has not left the play field yet
 	UPROPERTY(EditAnywhere, BlueprintReadWrite)
-	float velocity;
+	float lifetime;
 
 
 	// Sets default values for this actor's properties
 	ABullet();
 
-protected:
-	// Called when the game starts or when spawned
-	virtual void BeginPlay() override;
-
-	virtual void NotifyActorBeginOverlap(AActor* OtherActor) override;
-
-public:
-	// Called every frame
-	virtual void Tick(float DeltaTime) override;
-
 	UFUNCTION(BlueprintCallable)
 	void SetBulletMesh(class UStaticMesh* staticMesh = nullptr, FString path = TEXT(""),
 	                   FVector scale = FVector(1.0f, 1.0f, 1.0f));
 
+	// Radius used by the UBulletManager hit tests. Valid on the class defaults (the mesh is not registered).
+	float GetHitRadius() const;
+
 private:
 	static constexpr const TCHAR* defaultStaticMeshPath = TEXT("StaticMesh'/Engine/BasicShapes/Cube.Cube'");
-
-	FName autoDestroyTags[4] = {TEXT("BottomLimit"),TEXT("RightLimit"),TEXT("LeftLimit"),TEXT("TopLimit")};
 };
@@ -0,0 +1,99 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Flying bullets as parallel arrays (structure of arrays), one entry per bullet.
+ * OwnerType is the faction of the bullet (BulletType in the game, ESimFaction in the headless simulation).
+ * Removing a bullet swaps the last one into its place, so the order is not stable.
+ */
+template <typename OwnerType>
+struct TBulletArrays
+{
+	TArray<float> positionX;
+	TArray<float> positionY;
+	TArray<float> positionZ;
+	TArray<float> velocityX; // Direction * speed
+	TArray<float> velocityY;
+	TArray<float> velocityZ;
+	TArray<float> lifetime; // Seconds left
+	TArray<OwnerType> owner;
+	TArray<FQuat4f> rotation; // Only used to render
+
+	int32 Num() const { return owner.Num(); }
+
+	FVector GetLocation(int32 index) const { return FVector(positionX[index], positionY[index], positionZ[index]); }
+
+	void Reserve(int32 count)
+	{
+		positionX.Reserve(count);
+		positionY.Reserve(count);
+		positionZ.Reserve(count);
+		velocityX.Reserve(count);
+		velocityY.Reserve(count);
+		velocityZ.Reserve(count);
+		lifetime.Reserve(count);
+		owner.Reserve(count);
+		rotation.Reserve(count);
+	}
+
+	int32 Add(const FVector& location, const FQuat& bulletRotation, const FVector& dir, float speed,
+	          float bulletLifetime, OwnerType bulletOwner)
+	{
+		positionX.Add(location.X);
+		positionY.Add(location.Y);
+		positionZ.Add(location.Z);
+		velocityX.Add(dir.X * speed);
+		velocityY.Add(dir.Y * speed);
+		velocityZ.Add(dir.Z * speed);
+		lifetime.Add(bulletLifetime);
+		rotation.Add(FQuat4f(bulletRotation));
+		return owner.Add(bulletOwner);
+	}
+
+	void RemoveAtSwap(int32 index)
+	{
+		positionX.RemoveAtSwap(index, 1, EAllowShrinking::No);
+		positionY.RemoveAtSwap(index, 1, EAllowShrinking::No);
+		positionZ.RemoveAtSwap(index, 1, EAllowShrinking::No);
+		velocityX.RemoveAtSwap(index, 1, EAllowShrinking::No);
+		velocityY.RemoveAtSwap(index, 1, EAllowShrinking::No);
+		velocityZ.RemoveAtSwap(index, 1, EAllowShrinking::No);
+		lifetime.RemoveAtSwap(index, 1, EAllowShrinking::No);
+		owner.RemoveAtSwap(index, 1, EAllowShrinking::No);
+		rotation.RemoveAtSwap(index, 1, EAllowShrinking::No);
+	}
+
+	// Moves every bullet and consumes its lifetime, four bullets per SIMD instruction
+	void Integrate(float DeltaTime)
+	{
+		const int32 num = Num();
+		float* px = positionX.GetData();
+		float* py = positionY.GetData();
+		float* pz = positionZ.GetData();
+		const float* vx = velocityX.GetData();
+		const float* vy = velocityY.GetData();
+		const float* vz = velocityZ.GetData();
+		float* life = lifetime.GetData();
+
+		// position += velocity * DeltaTime, lifetime -= DeltaTime (unaligned loads, the arrays are plain TArrays)
+		const VectorRegister4Float delta = VectorSetFloat1(DeltaTime);
+		int32 i = 0;
+		for (; i + 4 <= num; i += 4)
+		{
+			VectorStore(VectorMultiplyAdd(VectorLoad(vx + i), delta, VectorLoad(px + i)), px + i);
+			VectorStore(VectorMultiplyAdd(VectorLoad(vy + i), delta, VectorLoad(py + i)), py + i);
+			VectorStore(VectorMultiplyAdd(VectorLoad(vz + i), delta, VectorLoad(pz + i)), pz + i);
+			VectorStore(VectorSubtract(VectorLoad(life + i), delta), life + i);
+		}
+		for (; i < num; i++)
+		{
+			px[i] += vx[i] * DeltaTime;
+			py[i] += vy[i] * DeltaTime;
+			pz[i] += vz[i] * DeltaTime;
+			life[i] -= DeltaTime;
+		}
+	}
+};
@@ -0,0 +1,109 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BulletArrays.h"
+#include "SpatialHash.h"
+
+// The player as a hit target
+struct FHitPassPlayer
+{
+	FVector2D location = FVector2D::ZeroVector;
+	float radius = 0.0f;
+	bool bHittable = false; // False while it explodes or when there is no player
+};
+
+/**
+ * The bullet rules of one frame, shared by UBulletManager and FInvaderSimulation: bullets out of time or out of
+ * the play field are removed, a player bullet shoots down the first invader it touches, invader bullets and
+ * invaders hit the player, and free-jumpers that left the play field are removed.
+ * Invaders are identified by the ids the caller gives them (an index in its own arrays), and the caller applies
+ * the hits: Begin, AddInvader for every live invader, Resolve, then remove GetLeaving().
+ */
+template <typename OwnerType>
+class TBulletHitPass
+{
+public:
+	FBox2D playField = FBox2D(FVector2D(-UE_BIG_NUMBER), FVector2D(UE_BIG_NUMBER));
+	OwnerType playerFaction = OwnerType(); // Owner of the bullets that hit invaders, the others hit the player
+	float playerBulletRadius = 0.0f;
+	float invaderBulletRadius = 0.0f;
+
+	// Empties the grid of invaders. Cells are cellSize wide.
+	void Begin(float cellSize, int32 expectedInvaders)
+	{
+		invaderGrid.Reset(cellSize, expectedInvaders);
+		leaving.Reset();
+	}
+
+	// Free-jumpers out of the play field cannot be hit, they are only left to GetLeaving()
+	void AddInvader(int32 id, const FVector2D& location, float radius, bool bFreeJumping)
+	{
+		if (bFreeJumping && !playField.IsInside(location))
+		{
+			leaving.Add(id);
+			return;
+		}
+		invaderGrid.Add(id, location, radius);
+	}
+
+	/**
+	 * Tests the bullets against the invaders added since Begin and against the player.
+	 * removeBullet(index) removes a bullet from bullets (the caller may keep counts of its own), isHittable(id)
+	 * skips the invaders already shot down, hitInvader(id) shoots one down and hitPlayer() is called at most once.
+	 */
+	template <typename RemoveType, typename HittableType, typename HitInvaderType, typename HitPlayerType>
+	void Resolve(const TBulletArrays<OwnerType>& bullets, FHitPassPlayer player, RemoveType&& removeBullet,
+	             HittableType&& isHittable, HitInvaderType&& hitInvader, HitPlayerType&& hitPlayer)
+	{
+		// Bullets out of the play field or out of time are removed (backwards: removing swaps the last one in)
+		for (int32 i = bullets.Num() - 1; i >= 0; i--)
+		{
+			if (bullets.lifetime[i] <= 0.0f || !playField.IsInside(FVector2D(bullets.positionX[i], bullets.positionY[i])))
+				removeBullet(i);
+		}
+
+		invaderGrid.Build();
+
+		// Player bullets against invaders, invader bullets against the player
+		for (int32 i = bullets.Num() - 1; i >= 0; i--)
+		{
+			FVector2D bulletLocation(bullets.positionX[i], bullets.positionY[i]);
+			if (bullets.owner[i] == playerFaction)
+			{
+				int32 id = invaderGrid.FindOverlap(bulletLocation, playerBulletRadius, isHittable);
+				if (id != INDEX_NONE)
+				{
+					removeBullet(i);
+					hitInvader(id);
+				}
+			}
+			else if (player.bHittable && FVector2D::DistSquared(bulletLocation, player.location)
+				<= FMath::Square(player.radius + invaderBulletRadius))
+			{
+				removeBullet(i);
+				hitPlayer();
+				player.bHittable = false; // The player is frozen while it explodes
+			}
+		}
+
+		// Invaders crashing against the player
+		if (player.bHittable)
+		{
+			int32 id = invaderGrid.FindOverlap(player.location, player.radius, isHittable);
+			if (id != INDEX_NONE)
+			{
+				leaving.AddUnique(id);
+				hitPlayer();
+			}
+		}
+	}
+
+	// Free-jumpers out of the play field and the invader that crashed, removed by the caller once the pass is done
+	const TArray<int32>& GetLeaving() const { return leaving; }
+
+private:
+	FSpatialHash invaderGrid;
+	TArray<int32> leaving;
+};
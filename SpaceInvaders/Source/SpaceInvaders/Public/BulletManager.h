@@ -0,0 +1,138 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Bullet.h"
+#include "BulletArrays.h"
+#include "BulletHitPass.h"
+#include "BulletManager.generated.h"
+
+// Occupancy of the bullets of one BulletType. Use highWaterMark to size the prewarm counts.
+USTRUCT(BlueprintType)
+struct FBulletPoolStats
+{
+	GENERATED_BODY()
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+	int32 capacity = 0; // Bullets that fit in the arrays and instances without growing them
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+	int32 inUse = 0; // Bullets currently flying
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+	int32 highWaterMark = 0; // Maximum of inUse since the world started
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+	int32 overflowSpawns = 0; // Bullets fired while the capacity was exhausted
+};
+
+// Rendering and hit test settings shared by the bullets of one BulletType
+USTRUCT()
+struct FBulletPool
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	TSubclassOf<ABullet> bulletClass;
+
+	UPROPERTY()
+	class UInstancedStaticMeshComponent* Instances; // One instance per bullet, spare ones have zero scale
+
+	UPROPERTY()
+	FBulletPoolStats stats;
+
+	float hitRadius = 0.0f;
+	float lifetime = 0.0f;
+	FVector meshScale = FVector::OneVector;
+
+	int32 visibleInstances = 0; // Instances showing a bullet after the last update, the rest have zero scale
+	TArray<FTransform> instanceTransforms; // Scratch buffer for the instance update
+};
+
+using FBulletArrays = TBulletArrays<BulletType>;
+
+UCLASS(Config=Game)
+class SPACEINVADERS_API UBulletManager : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	// Reserves room (arrays and mesh instances) for at least count bullets of bulletType
+	UFUNCTION(BlueprintCallable)
+	void Prewarm(TSubclassOf<ABullet> bulletClass, BulletType bulletType, int32 count);
+
+	// Launches a bullet. bulletClass is only read the first time a bullet of bulletType is fired.
+	UFUNCTION(BlueprintCallable)
+	void FireBullet(TSubclassOf<ABullet> bulletClass, BulletType bulletType, FVector location,
+	                FRotator rotation, FVector dir, float velocity);
+
+	UFUNCTION(BlueprintCallable)
+	int32 GetNumBullets() const;
+
+	UFUNCTION(BlueprintCallable)
+	FBulletPoolStats GetPoolStats(BulletType bulletType) const;
+
+	// Hit test targets
+	void RegisterInvader(class AInvader* invader);
+	void UnregisterInvader(class AInvader* invader);
+	void RegisterPlayer(class ASIPawn* pawn);
+
+	// Area inside the actors tagged as LeftLimit / RightLimit / BottomLimit / TopLimit (X is up, Y is right)
+	const FBox2D& GetPlayField() const { return playField; }
+
+	// Tests every flying bullet and free-jumper and dispatches the hits
+	void ResolveHits();
+
+	// Copies the bullet positions to the instanced meshes
+	void UpdateInstances();
+
+	// Width of the spatial hash cells. Should be about the diameter of an invader.
+	// Read from the [/Script/SpaceInvaders.BulletManager] section of DefaultGame.ini.
+	UPROPERTY(Config)
+	float hitGridCellSize = 200.0f;
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	UPROPERTY()
+	TArray<FBulletPool> pools; // Indexed by BulletType
+
+	FBulletArrays bullets;
+
+	UPROPERTY()
+	AActor* InstancesOwner; // Hosts the instanced meshes of the bullets
+
+	UPROPERTY()
+	TArray<class AInvader*> invaders; // Registered targets of the player bullets
+
+	UPROPERTY()
+	class ASIPawn* PlayerPawn; // Target of the invader bullets and free-jumpers
+
+	FBox2D playField;
+
+	TBulletHitPass<BulletType> hitPass;
+	TArray<class AInvader*> hitTargets; // Invaders in hitPass, indexed by their ids
+
+	// Reads the bullet class defaults and creates the instanced mesh of the pool
+	bool SetupPool(FBulletPool& pool, TSubclassOf<ABullet> bulletClass);
+
+	void GrowInstances(FBulletPool& pool, int32 count);
+
+	void RemoveBullet(int32 index);
+
+	void FindPlayField();
+
+	static constexpr const TCHAR* limitTags[4] = {
+		TEXT("LeftLimit"), TEXT("RightLimit"), TEXT("BottomLimit"), TEXT("TopLimit")
+	};
+};
@@ -0,0 +1,113 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "EffectManager.generated.h"
+
+// Reusable components of one Niagara system
+USTRUCT()
+struct FEffectPool
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	class UNiagaraSystem* System = nullptr;
+
+	UPROPERTY()
+	TArray<class UNiagaraComponent*> Components;
+
+	TArray<double> startTimes; // Last activation of every component
+	TArray<bool> playing; // Started and not finished yet, counted in UEffectManager::numActive
+};
+
+// Effect waiting for the activation budget of a later frame
+USTRUCT()
+struct FPendingEffect
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	class UNiagaraSystem* System = nullptr;
+
+	FVector location = FVector::ZeroVector;
+	FRotator rotation = FRotator::ZeroRotator;
+	double requestTime = 0.0;
+};
+
+/**
+ * Plays the one-shot effects of the game (explosions) with pooled Niagara components instead of spawning
+ * and destroying one per death. At most maxActiveEffects play at once (the oldest one of any system is
+ * recycled when full) and at most maxActivationsPerFrame start in one frame; the rest wait a few frames.
+ * Requests close to one of the same system already started this frame are merged into it.
+ * The limits are read from the [/Script/SpaceInvaders.EffectManager] section of DefaultGame.ini.
+ */
+UCLASS(Config=Game)
+class SPACEINVADERS_API UEffectManager : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Deinitialize() override;
+
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	// Creates components until the pool of system has count of them
+	UFUNCTION(BlueprintCallable)
+	void Prewarm(class UNiagaraSystem* system, int32 count);
+
+	UFUNCTION(BlueprintCallable)
+	void SpawnEffect(class UNiagaraSystem* system, FVector location, FRotator rotation);
+
+	UFUNCTION(BlueprintCallable)
+	int32 GetNumActive() const;
+
+	UPROPERTY(Config)
+	int32 maxActiveEffects = 24;
+
+	UPROPERTY(Config)
+	int32 maxActivationsPerFrame = 6;
+
+	UPROPERTY(Config)
+	float maxQueueDelay = 0.1f; // Seconds a request may wait for the activation budget before it is dropped
+
+	// Requests this close to an effect of the same system started in the same frame are merged into it
+	UPROPERTY(Config)
+	float mergeRadius = 100.0f;
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	UPROPERTY()
+	TArray<FEffectPool> pools;
+
+	UPROPERTY()
+	TArray<FPendingEffect> pending;
+
+	UPROPERTY()
+	AActor* EffectsOwner; // Hosts the Niagara components
+
+	int32 numActive = 0; // Effects playing in every pool
+
+	TArray<FPendingEffect> startedThisFrame; // Systems and locations, for merging
+	uint64 activationFrame = 0;
+	int32 activationsThisFrame = 0;
+
+	FEffectPool* FindOrAddPool(class UNiagaraSystem* system);
+
+	class UNiagaraComponent* CreateComponent(FEffectPool& pool);
+
+	// Starts the effect unless the frame budget is exhausted. Returns false when it has to wait.
+	bool TryActivate(const FPendingEffect& effect);
+
+	// Stops the effect at index of pool to make room for another system
+	void StopEffect(FEffectPool& pool, int32 index);
+
+	UFUNCTION()
+	void OnEffectFinished(class UNiagaraComponent* component);
+
+	void BeginFrame();
+};
@@ -0,0 +1,58 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Next fire time of every shooter of a squad in a min-heap, so a frame costs O(shots fired) instead of a roll per
+ * invader. Shooters are identified by slot. Cancelled and rescheduled shots stay in the heap until they reach the
+ * top (a generation per slot tells them apart), and the heap is compacted when they pile up.
+ */
+class SPACEINVADERS_API FFireScheduler
+{
+public:
+	/**
+	 * Time to the next shot of a shooter with the given fire rate, u uniform in [0, 1).
+	 * The old rolls against ExponentialChance(rate, timeFromLastShot) every frame add up to a hazard of
+	 * rate * t / referenceFrameTime at 60 fps, whose survival exp(-rate * t^2 / (2 * referenceFrameTime))
+	 * is inverted here. The delay no longer depends on the frame rate.
+	 */
+	static float SampleDelay(float rate, float u);
+
+	// Cancels everything and makes room for numSlots shooters
+	void Reset(int32 numSlots);
+
+	// Schedules the next shot of slot at fireTime, replacing the pending one
+	void Schedule(int32 slot, float fireTime);
+
+	void Cancel(int32 slot);
+
+	bool IsScheduled(int32 slot) const { return scheduled.IsValidIndex(slot) && scheduled[slot]; }
+
+	// Removes the earliest shot due at now or before and returns its slot, INDEX_NONE if none is due
+	int32 PopDue(float now);
+
+	int32 NumScheduled() const { return numScheduled; }
+
+	static constexpr float referenceFrameTime = 1.0f / 60.0f;
+
+private:
+	struct FShot
+	{
+		float time;
+		int32 slot;
+		uint32 generation;
+
+		bool operator<(const FShot& other) const { return time < other.time; }
+	};
+
+	TArray<FShot> heap;
+	TArray<uint32> generations; // Current generation of every slot, older shots in the heap are stale
+	TBitArray<> scheduled;
+	int32 numScheduled = 0;
+
+	bool IsStale(const FShot& shot) const { return !scheduled[shot.slot] || shot.generation != generations[shot.slot]; }
+
+	void Compact();
+};
@@ -0,0 +1,56 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+struct FFormationSlots;
+
+// Phases of the squad march. Same values as InvaderMovementType, so they can be cast to each other.
+enum class EMarchPhase : uint8
+{
+	Stop = 0,
+	Right = 1,
+	Left = 2,
+	Down = 3
+};
+
+/**
+ * Where every slot of a formation is, relative to the squad root (X is up, Y is right).
+ * Members are laid out from the root towards +X (rows) and +Y (columns).
+ */
+struct SPACEINVADERS_API FFormationLayout
+{
+	TArray<float> columnOffsets; // Y of every column
+	TArray<float> rowOffsets; // Lowest X of every row
+	float memberRadius = 0.0f;
+
+	// Evenly spaced layout, separation is the distance between neighbouring slots
+	void InitGrid(int32 numColumns, int32 numRows, float separation, float radius);
+
+	FVector2D GetSlotOffset(const FFormationSlots& slots, int32 slot) const;
+
+	// Formation AABB from the outermost columns and front row still in formation. The back row is not needed.
+	bool GetBounds(const FFormationSlots& slots, const FVector2D& origin, FBox2D& bounds) const;
+};
+
+/**
+ * Rules of the squad march: walk to one side of the play field, descend one step, walk to the other side,
+ * until the formation reaches the bottom.
+ */
+struct SPACEINVADERS_API FFormationMarch
+{
+	EMarchPhase phase = EMarchPhase::Stop;
+	EMarchPhase sidePhase = EMarchPhase::Stop; // Side walked before the current descent
+	float descendingProgress = 0.0f; // Progress of the current descending step
+	bool bLanded = false;
+
+	// Offset of the squad root after delta seconds. The descent ends once descendingStep has been covered.
+	FVector2D Step(float delta, float horizontalVelocity, float verticalVelocity, float descendingStep);
+
+	// The formation reached the limit of the side it walks towards
+	void StartDescent(EMarchPhase side);
+
+	// Turns around at the side limits. Returns true the first time the formation reaches the bottom.
+	bool CheckLimits(const FBox2D& bounds, const FBox2D& playField);
+};
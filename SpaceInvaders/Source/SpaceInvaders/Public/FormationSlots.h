@@ -0,0 +1,70 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Occupancy of a squad formation by slot, with no actor in it (FInvaderRoster adds the actors).
+ * Bitsets tell which slots are alive, which ones are still marching in formation and which
+ * ones are free-jumping, so counting and random picks need no allocation.
+ * Slots are laid out column by column (slot = column * numRows + row), and a row/column bitboard
+ * of the formation gives its outermost columns and its front row with a bit-scan.
+ */
+struct SPACEINVADERS_API FFormationSlots
+{
+public:
+	// Empties the formation and reserves room for numColumns x numRows slots
+	void Reset(int32 numColumns, int32 numRows);
+
+	// Appends an alive, in formation slot. Returns it.
+	int32 Add();
+
+	// The member is dead (shot down or crashed): it leaves the alive and formation sets
+	bool MarkDead(int32 slot);
+
+	// The member leaves the formation to start its free jump
+	bool MarkFreeJump(int32 slot);
+
+	bool IsAlive(int32 slot) const { return alive.IsValidIndex(slot) && alive[slot]; }
+	bool IsInFormation(int32 slot) const { return inFormation.IsValidIndex(slot) && inFormation[slot]; }
+
+	int32 Num() const { return alive.Num(); }
+	int32 NumAlive() const { return numAlive; }
+	int32 NumInFormation() const { return numInFormation; }
+
+	// Slot of the n-th (0 based) member in formation, INDEX_NONE if there are not so many
+	int32 FindNthInFormation(int32 n) const;
+
+	int32 GetColumn(int32 slot) const { return slot / rowsPerColumn; }
+	int32 GetRow(int32 slot) const { return slot % rowsPerColumn; }
+
+	// Outermost columns and front row (row 0 side) with members in formation, INDEX_NONE if the formation is empty
+	int32 FirstColumnInFormation() const { return columnsInFormation.Find(true); }
+	int32 LastColumnInFormation() const { return columnsInFormation.FindLast(true); }
+	int32 FirstRowInFormation() const { return rowsInFormation.Find(true); }
+
+	// Front-most member in formation (lowest row) of a column, INDEX_NONE if the column is empty
+	int32 FindFrontInColumn(int32 column) const;
+
+	const TBitArray<>& GetAliveBits() const { return alive; }
+	const TBitArray<>& GetInFormationBits() const { return inFormation; }
+	const TBitArray<>& GetFreeJumpBits() const { return freeJumping; }
+
+private:
+	TBitArray<> alive;
+	TBitArray<> inFormation;
+	TBitArray<> freeJumping; // Alive and out of the formation
+
+	// Formation bitboard: members in formation per column / row, and the columns / rows that still have any
+	int32 rowsPerColumn = 1;
+	TArray<int32> columnCount;
+	TArray<int32> rowCount;
+	TBitArray<> columnsInFormation;
+	TBitArray<> rowsInFormation;
+
+	int32 numAlive = 0;
+	int32 numInFormation = 0;
+
+	void LeaveFormation(int32 slot);
+};
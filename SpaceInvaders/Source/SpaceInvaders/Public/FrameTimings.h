@@ -0,0 +1,51 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// Parts of the game-thread frame measured by FFrameTimings
+enum class EFrameSection : uint8
+{
+	Squad = 0, // AInvaderSquad::Tick
+	Invaders, // AInvader::Tick (fire decisions)
+	Movement, // UInvaderMovementComponent::TickComponent and MoveInvaders
+	Bullets, // Bullet integration and instance update
+	HitTests, // UBulletManager::ResolveHits and the hits it dispatches
+	Num
+};
+
+/**
+ * Game-thread time spent in every EFrameSection since the last Reset(). Only game-thread code is measured,
+ * so the counters are plain statics. Disabled by default: the scopes then cost a branch.
+ */
+struct SPACEINVADERS_API FFrameTimings
+{
+	static bool bEnabled;
+	static uint64 cycles[(int32)EFrameSection::Num];
+
+	static void Reset();
+	static double GetMilliseconds(EFrameSection section);
+	static const TCHAR* GetName(EFrameSection section);
+};
+
+// Adds the time until the end of the scope to a section of FFrameTimings
+class FScopedFrameSection
+{
+public:
+	explicit FScopedFrameSection(EFrameSection inSection)
+		: section{inSection}
+		  , start{FFrameTimings::bEnabled ? FPlatformTime::Cycles64() : 0}
+	{
+	}
+
+	~FScopedFrameSection()
+	{
+		if (start != 0)
+			FFrameTimings::cycles[(int32)section] += FPlatformTime::Cycles64() - start;
+	}
+
+private:
+	EFrameSection section;
+	uint64 start;
+};
@@ -0,0 +1,28 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Reference poses of the first stage of a free jump: a circle through numberOfTargetPoints poses,
+ * relative to the transform where the jump starts. The invader interpolates between them.
+ * The trigonometry is done once per numberOfTargetPoints and the table is shared by every invader.
+ */
+struct SPACEINVADERS_API FFreeJumpPoses
+{
+	TArray<FVector> offsets; // Around a unit circle, multiplied by the jump radius
+	TArray<FQuat> rotations; // Applied before the initial rotation
+
+	// Shared table for numberOfTargetPoints, built the first time it is asked for (game thread only)
+	static const FFreeJumpPoses& Get(int32 numberOfTargetPoints);
+
+	int32 Num() const { return offsets.Num(); }
+
+	// Reference pose index of a jump started at origin
+	FTransform GetTargetPoint(const FTransform& origin, float radius, int32 index) const;
+
+	// Pose of a jump started at origin, time seconds later. Each reference pose is reached targetPointTime
+	// seconds after the previous one; after the last one the pose stays there.
+	FTransform Evaluate(const FTransform& origin, float radius, float targetPointTime, float time) const;
+};
@@ -15,22 +15,23 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite)
 	class UStaticMeshComponent* Mesh;
 
+	// Assets are soft references: the game mode streams them in before spawning the squad
 	UPROPERTY(EditAnywhere, BlueprintReadWrite)
-	TArray<UStaticMesh*> InvaderMeshes;
+	TArray<TSoftObjectPtr<UStaticMesh>> InvaderMeshes;
 
 	UPROPERTY(EditAnywhere, BlueprintReadWrite)
-	float fireRate;
+	float fireRate; // Shots are scheduled by the squad (FFireScheduler) from this rate
 
 	UPROPERTY(EditAnywhere, BlueprintReadWrite)
 	float bulletVelocity;
 
 	//Audio
 	UPROPERTY(EditAnywhere, BlueprintReadWrite)
-	class USoundCue* AudioShoot;
+	TSoftObjectPtr<class USoundCue> AudioShoot;
 	UPROPERTY(EditAnywhere, BlueprintReadWrite)
-	class USoundCue* AudioExplosion;
+	TSoftObjectPtr<class USoundCue> AudioExplosion;
 	UPROPERTY(EditAnywhere, BlueprintReadWrite)
-	class USoundCue* AudioJet;
+	TSoftObjectPtr<class USoundCue> AudioJet;
 
 	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite)
 	TSubclassOf<class ABullet> bulletClass;
@@ -39,7 +40,7 @@ public:
 	class UInvaderMovementComponent* Movement;
 	
 	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite)
-	class UNiagaraSystem* ExplosionEffect;
+	TSoftObjectPtr<class UNiagaraSystem> ExplosionEffect;
 
 	
 
@@ -51,8 +52,11 @@ public:
 	// Called every frame
 	virtual void Tick(float DeltaTime) override;
 
-	virtual void NotifyActorBeginOverlap(AActor* OtherActor) override;
+	// Adds the meshes, sounds and effects of this invader to a preload bundle
+	void GetAssetsToPreload(TArray<FSoftObjectPath>& assets) const;
 
+	// Without staticMesh, the mesh at path (or the default cube) is used if it is loaded, otherwise it is
+	// streamed in and set when it arrives
 	UFUNCTION(BlueprintCallable)
 	void SetInvaderMesh(class UStaticMesh* staticMesh = nullptr, const FString path = TEXT(""),
 	                    FVector scale = FVector(1.0f, 1.0f, 1.0f));
@@ -66,38 +70,84 @@ public:
 	UFUNCTION(BlueprintCallable)
 	int32 GetPositionInSquad();
 
+	// Id of the squad it belongs to (AInvaderSquad::GetSquadId), its kills are routed there
+	void SetSquadId(int32 id);
+
 	UFUNCTION(BlueprintCallable)
 	float GetBoundRadius();
 
+	// Largest bound radius among the loaded InvaderMeshes at the scale of Mesh, 0 if none is loaded
+	float GetMaxMeshRadius() const;
+
+	// Index in InvaderMeshes of the mesh chosen in BeginPlay (INDEX_NONE if none)
+	UFUNCTION(BlueprintCallable)
+	int32 GetMeshIndex();
+
+	// Shot down by a player bullet: explodes and is destroyed a while later
+	void HitByBullet();
+
+	// Crashed against the player or left the play field while free jumping: removed without exploding
+	void SilentDestroy();
+
+	// Invader pool of ASIGameModeBase: back in play for a new wave, with a new mesh and its initial fire rate
+	void OnAcquired(const FVector& location, const FRotator& rotation);
+
+	// Out of play until the next wave: hidden, not ticking, not hit tested
+	void OnReleased();
+
+	bool IsInPool() const;
+
+	// Exploding after a hit, it can't be hit again
+	bool IsDying() const;
+
+	bool IsFreeJumping() const;
+
+	// Members of a squad are driven by it: their own tick and the one of Movement stay off while they are
+	// driven. Free-jumpers are moved in batches (by the game mode, or by the squad tick), and dying invaders
+	// stay stopped.
+	void SetDrivenBySquad(bool bDriven);
+
+	// Leaves the formation: detaches from the squad and fires more often
+	void StartFreeJump();
+
+	// Stream of the random decisions of this invader (mesh, attack angle), seeded by the game mode
+	void SetRandomSeed(int32 seed);
+	const FRandomStream& GetRandom() const { return random; }
+
 protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
 
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
 private:
 	UPROPERTY()
-	class ABullet* bulletTemplate;
+	class UBulletManager* BulletManager; // Fires, moves and hit tests the bullets
 
 	// Private Attributes
 	UPROPERTY()
-	class UAudioComponent* AudioComponent;
+	class UAudioVoiceManager* AudioManager; // Plays the shots and explosions with a shared pool of voices
+
+	UPROPERTY()
+	class UEffectManager* EffectManager; // Plays the explosions with pooled Niagara components
 
 	UPROPERTY(VisibleInstanceOnly)
 	int32 positionInSquad;
 
 	UPROPERTY(VisibleInstanceOnly)
-	float timeFromLastShot;
-
-	UPROPERTY(VisibleAnywhere)
-	FName leftSideTag;
-
-	UPROPERTY(VisibleAnywhere)
-	FName rightSideTag;
-
-	UPROPERTY(VisibleAnywhere)
-	FName downSideTag;
+	int32 squadId;
 
 	bool bFrozen;
 	bool bPause;
+	bool bDrivenBySquad;
+	float baseFireRate; // fireRate when it began play, free jumps raise it
+	bool bInPool;
+
+	// Picks one of InvaderMeshes
+	void ChooseMesh();
+
+	// Back to the pool of the game mode, or destroyed if there is none
+	void Remove();
 
 	// Timer to control waiting after destruction
 	FTimerHandle timerHandle;
@@ -114,11 +164,13 @@ private:
 	UPROPERTY(VisibleInstanceOnly)
 	float boundRadius;
 
+	UPROPERTY(VisibleInstanceOnly)
+	int32 meshIndex;
+
+	FRandomStream random;
+
 
 	// Static literals of the class
 
 	static constexpr const TCHAR* defaultStaticMeshName = TEXT("StaticMesh'/Engine/BasicShapes/Cube.Cube'");
-	static constexpr const TCHAR* leftSideTagString = TEXT("LeftLimit");
-	static constexpr const TCHAR* rightSideTagString = TEXT("RightLimit");
-	static constexpr const TCHAR* downSideTagString = TEXT("BottomLimit");
 };
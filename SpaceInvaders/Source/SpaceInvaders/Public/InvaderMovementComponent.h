@@ -16,6 +16,46 @@ enum class InvaderMovementType : uint8
 	FREEJUMP = 4 UMETA(DisplayName = "Free Jump")
 };
 
+/**
+ * Movement of one invader without any UObject: the parameters of its UInvaderMovementComponent, the actor
+ * transform and the progress of the current movement. Stepping it only reads the shared free jump tables,
+ * so the invaders of a batch are stepped in parallel (see UInvaderMovementComponent::MoveInvaders).
+ */
+struct SPACEINVADERS_API FInvaderKinematics
+{
+	// Copied from the component every step
+	InvaderMovementType state = InvaderMovementType::STOP;
+	float horizontalVelocity = 0.0f;
+	float verticalVelocity = 0.0f;
+	float descendingStep = 0.0f;
+	float freeJumpRadius = 0.0f;
+	float freeJumpVelocity = 0.0f;
+	float targetPointTime = 0.0f;
+	bool bAttached = false; // Moved with its squad: only the progress is updated
+	FTransform transform; // Actor transform before the step, the new one after it
+	bool bMoved = false; // transform has to be applied to the actor
+
+	InvaderMovementType previousState = InvaderMovementType::STOP; // To know when a state is beginning
+
+	// Down movement state variables:
+	float descendingProgress = 0.0f; // Store progress in the Down state
+
+	// Free jump movement state variables:
+	FTransform originTransform; // Actor transform when the jump started, the reference poses are relative to it
+	const struct FFreeJumpPoses* freeJumpPoses = nullptr; // Shared by every jump with the same numberOfTargetPoints
+	float freeJumpTime = 0.0f; // Seconds since the jump started
+	bool bFreeJumpAttack = false; // Second stage: flying towards the player
+	float finalAngle = 0.0f; // Orientation of the invader to start the final attack
+
+	// Starts a free jump at transform (game thread, the pose tables are built on demand)
+	void BeginFreeJump(int32 numberOfTargetPoints);
+
+	// Advances deltaTime seconds. playerLocation is only used when bHasPlayer.
+	void Step(float deltaTime, const FVector& playerLocation, bool bHasPlayer);
+
+	FTransform EvaluateFreeJump(float time) const;
+};
+
 
 UCLASS()
 class SPACEINVADERS_API UInvaderMovementComponent : public UMovementComponent
@@ -43,10 +83,7 @@ public:
 
 
 	// Free jump parameters:
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Invader Movement")
-	TArray<FTransform> targetPoints;
-	// The movement will be composed by interpolation using a sequence of reference poses stored in this array.
-
+	// The first stage is a circle through numberOfTargetPoints reference poses, the invader interpolates between them.
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Invader Movement")
 	int32 numberOfTargetPoints;
 
@@ -54,37 +91,53 @@ public:
 	float freeJumpRadius;
 
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Invader Movement")
-	float freeJumpVelocity; // Velocity in the first stage of the free jump
+	float freeJumpVelocity; // Velocity in the second stage of the free jump
 
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Invader Movement")
-	float deltaAlphaInterpolation; //1/(Number of updates between two target points)
+	float targetPointTime; // Seconds to go from one reference pose to the next
 
 public:
 	// Called every frame
 	virtual void TickComponent(float DeltaTime, ELevelTick TickType,
 	                           FActorComponentTickFunction* ThisTickFunction) override;
 
+	// Back to STOP with no descent or free jump in progress (invaders reused from the pool)
+	void ResetMovement();
+
+	// Moves the owners of movements as their ticks would: the kinematics are gathered into the contiguous
+	// scratch array, stepped in parallel and the new transforms applied in one pass on the game thread
+	static void MoveInvaders(TConstArrayView<UInvaderMovementComponent*> movements, float deltaTime,
+	                         TArray<FInvaderKinematics>& scratch);
+
+	// Moved actors are teleported (hits are tested by the UBulletManager) inside an FScopedMovementUpdate, so
+	// their attachments and overlaps are refreshed once. Off, the old default SetActorTransform, to measure the
+	// difference (SI.ScopedMovement).
+	static bool bScopedMovementUpdates;
+
 protected:
 	// Called when the game starts
 	virtual void BeginPlay() override;
 
+	// Reference pose i of the current free jump
 	UFUNCTION(BlueprintCallable)
-	void GenerateTargetPoints();
+	FTransform GetTargetPoint(int32 index) const;
 
+	// Pose of the first stage of the free jump, seconds after it started
 	UFUNCTION(BlueprintCallable)
-	FTransform InterpolateWithTargetPoints(FTransform transform, float covered);
+	FTransform EvaluateFreeJump(float time) const;
 
 private:
-	InvaderMovementType previousState; // Store state in previous frame (to know when a state is beginning)
+	FInvaderKinematics kinematics;
 
-	// Down movement state variables:
-	float descendingProgress = 0.0f; // Store progress in the Down state
+	// Copies the parameters and the actor transform into kinematics (game thread)
+	void GatherKinematics();
 
-	// Free jump movement state variables:
-	FTransform originTransform;
-	float alphaInterpolation;
-	int32 currentTargetPoint = 0; // It stores the index of the first reference pose (the other is currentTargetPoint+1)
-	float finalAngle; // Orientation of the invader to start the final attack
+	// Writes the stepped transform back to the actor (game thread)
+	void ApplyKinematics();
+
+	static bool FindPlayerLocation(const UWorld* world, FVector& location);
+
+	float RandomFinalAngle() const;
 
-	class ASIGameModeBase* MyGameMode; // to call delegates
+	static const int32 minParallelBatch = 32; // Smaller batches are stepped on the game thread
 };
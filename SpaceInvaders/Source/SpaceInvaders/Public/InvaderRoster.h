@@ -0,0 +1,58 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "FormationSlots.h"
+#include "InvaderRoster.generated.h"
+
+/**
+ * Members of a squad stored by slot (the invader positionInSquad).
+ * Invaders and their movement components live in contiguous arrays and never leave holes;
+ * which slots are alive, in formation or free-jumping is kept by FFormationSlots.
+ */
+USTRUCT()
+struct SPACEINVADERS_API FInvaderRoster
+{
+	GENERATED_BODY()
+
+public:
+	// Empties the roster and reserves room for a numColumns x numRows formation
+	void Reset(int32 numColumns, int32 numRows);
+
+	// Appends an alive, in formation member. Returns its slot.
+	int32 Add(class AInvader* invader);
+
+	// The member is dead (shot down or crashed): it leaves the alive and formation sets
+	bool MarkDead(int32 slot) { return slots.MarkDead(slot); }
+
+	// The member leaves the formation to start its free jump
+	bool MarkFreeJump(int32 slot) { return slots.MarkFreeJump(slot); }
+
+	bool IsAlive(int32 slot) const { return slots.IsAlive(slot); }
+	bool IsInFormation(int32 slot) const { return slots.IsInFormation(slot); }
+
+	int32 Num() const { return invaders.Num(); }
+	int32 NumAlive() const { return slots.NumAlive(); }
+	int32 NumInFormation() const { return slots.NumInFormation(); }
+
+	// Slot of the n-th (0 based) member in formation, INDEX_NONE if there are not so many
+	int32 FindNthInFormation(int32 n) const { return slots.FindNthInFormation(n); }
+
+	class AInvader* GetInvader(int32 slot) const { return invaders[slot]; }
+	class UInvaderMovementComponent* GetMovement(int32 slot) const { return movements[slot]; }
+
+	const FFormationSlots& GetSlots() const { return slots; }
+	const TBitArray<>& GetAliveBits() const { return slots.GetAliveBits(); }
+	const TBitArray<>& GetInFormationBits() const { return slots.GetInFormationBits(); }
+	const TBitArray<>& GetFreeJumpBits() const { return slots.GetFreeJumpBits(); }
+
+private:
+	UPROPERTY(VisibleInstanceOnly)
+	TArray<class AInvader*> invaders;
+
+	UPROPERTY(VisibleInstanceOnly)
+	TArray<class UInvaderMovementComponent*> movements; // Cached Movement of every invader
+
+	FFormationSlots slots;
+};
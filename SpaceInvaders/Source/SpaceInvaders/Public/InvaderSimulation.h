@@ -0,0 +1,147 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "FormationSlots.h"
+#include "SquadRules.h"
+#include "BulletArrays.h"
+#include "BulletHitPass.h"
+#include "InvaderMovementComponent.h"
+
+// Owner of a bullet in the headless simulation (the game uses BulletType)
+enum class ESimFaction : uint8
+{
+	Player = 0,
+	Invader = 1
+};
+
+// Settings of the headless simulation. The defaults are the defaults of the actors.
+struct SPACEINVADERS_API FInvaderSimConfig
+{
+	// Squad
+	int32 numColumns = 11;
+	int32 numRows = 5;
+	float separation = 150.0f; // Distance between neighbouring slots
+	float invaderRadius = 50.0f;
+	FVector2D squadOrigin = FVector2D(1500.0f, -1200.0f); // Root of the formation, its front left corner
+	float horizontalVelocity = 300.0f;
+	float verticalVelocity = 300.0f;
+	float velocityIncreaser = 100.0f; // Added to the velocities of every new wave
+	float descendingStep = 100.0f;
+	float freeJumpRate = 0.0001f;
+
+	// Invaders
+	float fireRate = 0.0001f;
+	float freeJumpFireMultiplier = 100.0f; // Free-jumpers fire this much more often
+	float invaderBulletVelocity = 3000.0f;
+	int32 numberOfTargetPoints = 5;
+	float freeJumpRadius = 300.0f;
+	float targetPointTime = 0.5f;
+	float freeJumpVelocity = 1000.0f;
+
+	// Player
+	FVector2D playerLocation = FVector2D(0.0f, 0.0f);
+	float playerRadius = 50.0f;
+	float playerVelocity = 1000.0f;
+	float playerBulletVelocity = 3000.0f;
+	float playerFireInterval = 0.25f; // Minimum time between two player shots
+	float playerRespawnTime = 3.0f; // Frozen after a hit
+	int32 playerLifes = 3;
+	int32 pointsPerInvader = 100;
+	int32 pointsPerSquad = 1000;
+
+	// Bullets and play field (X is up, Y is right)
+	float bulletRadius = 10.0f;
+	float bulletLifetime = 5.0f;
+	FBox2D playField = FBox2D(FVector2D(-200.0f, -2000.0f), FVector2D(3000.0f, 2000.0f));
+	float hitGridCellSize = 200.0f;
+
+	// Defaults with numInvaders in rows of at most 5, the play field widened to fit the formation
+	static FInvaderSimConfig ForSquadSize(int32 numInvaders);
+};
+
+// Player input of one step
+struct FInvaderSimInput
+{
+	float move = 0.0f; // -1 left, 1 right
+	bool bFire = false;
+};
+
+/**
+ * The game rules without any UObject: squad march and descent, free jumps, fire decisions, bullets, hits,
+ * score and lives. It is advanced with a fixed step, so it can run headless (benchmarks, tests) and
+ * thousands of invaders can be simulated without a world. Every rule is the one the actors run:
+ * FSquadRules (AInvaderSquad), FInvaderKinematics (UInvaderMovementComponent) and TBulletHitPass
+ * (UBulletManager). Only the player, the score and the waves are kept here, as ASIPawn and the game mode do.
+ */
+class SPACEINVADERS_API FInvaderSimulation
+{
+public:
+	void Reset(const FInvaderSimConfig& newConfig, int32 seed);
+
+	void SetInput(const FInvaderSimInput& newInput) { input = newInput; }
+
+	// Advances the simulation deltaTime seconds. Does nothing once the game is over.
+	void Step(float deltaTime);
+
+	// Step with the input of the headless runs: the player sweeps the field and fires all the time
+	void StepAutopilot(float deltaTime);
+
+	bool IsGameOver() const { return lifes <= 0; }
+
+	int64 GetPoints() const { return points; }
+	int32 GetLifes() const { return lifes; }
+	int32 GetWave() const { return wave; }
+	int64 GetStepCount() const { return stepCount; }
+	int32 NumInvadersAlive() const { return slots.NumAlive(); }
+	int32 NumFreeJumping() const { return slots.NumAlive() - slots.NumInFormation(); }
+	int32 NumBullets() const { return bullets.Num(); }
+	const FVector2D& GetPlayerLocation() const { return playerLocation; }
+
+	// World position (XY) of an alive slot
+	FVector2D GetInvaderLocation(int32 slot) const;
+
+private:
+	FInvaderSimConfig config;
+	FRandomStream seeds; // Hands out the seeds of every wave, as the game mode does
+	FInvaderSimInput input;
+
+	// Squad
+	FFormationSlots slots;
+	FSquadRules rules;
+	FVector2D squadOrigin;
+	float horizontalVelocity = 0.0f;
+	float verticalVelocity = 0.0f;
+	int32 wave = 0;
+	TArray<int32> dueShooters;
+
+	// Free-jumpers by slot, moved as their movement components move them
+	TArray<FInvaderKinematics> jumpers;
+
+	TBulletArrays<ESimFaction> bullets;
+	TBulletHitPass<ESimFaction> hitPass;
+
+	// Player
+	FVector2D playerLocation;
+	float playerFrozenTime = 0.0f; // Seconds left exploding
+	float timeFromLastPlayerShot = 0.0f;
+	int64 points = 0;
+	int32 lifes = 0;
+	int64 stepCount = 0;
+
+	void SpawnWave();
+	void UpdateSquad(float deltaTime);
+	void UpdateInvaders(float deltaTime);
+	void FireDueShots();
+	float GetSlotFireRate(int32 slot) const;
+	void UpdatePlayer(float deltaTime);
+	void ResolveHits();
+
+	void FireBullet(ESimFaction faction, const FVector2D& location, const FVector2D& dir, float velocity);
+	void KillInvader(int32 slot);
+	void HitPlayer();
+
+	// The squad reached the bottom or was destroyed: a faster one comes, with the points of a squad
+	void NextWave();
+};
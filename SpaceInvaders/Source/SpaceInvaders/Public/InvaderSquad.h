@@ -4,9 +4,27 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
+#include "InvaderRoster.h"
+#include "SquadRules.h"
+#include "InvaderMovementComponent.h"
+#include "Tasks/Task.h"
 #include "InvaderSquad.generated.h"
 
-enum class InvaderMovementType : uint8;
+// Squad state the decisions read, copied on the game thread when they start (see AInvaderSquad::LaunchUpdate)
+struct FSquadSnapshot
+{
+	FFormationSlots slots;
+	FVector2D rootLocation = FVector2D::ZeroVector;
+	FSquadStepParams params;
+};
+
+// What the decisions of one step found, applied to the actors on the game thread by AInvaderSquad::ApplyUpdate
+struct FSquadDecisions
+{
+	FSquadStepResult step; // March, landing and free jump
+	TArray<int32> dueShooters; // Members firing
+	bool bReady = false; // Not applied yet
+};
 
 UCLASS()
 class SPACEINVADERS_API AInvaderSquad : public AActor
@@ -17,12 +35,6 @@ public:
 	UPROPERTY()
 	class USceneComponent* Root;
 
-	UPROPERTY(EditAnyWhere, BlueprintReadWrite, Category = "Squad movement")
-	InvaderMovementType state;
-
-	UPROPERTY(VisibleAnyWhere, BlueprintReadWrite, Category = "Squad movement")
-	InvaderMovementType previousState;
-
 	UPROPERTY(EditAnyWhere, BlueprintReadWrite, Category = "Squad movement")
 	float freeJumpRate;
 
@@ -35,11 +47,29 @@ public:
 	UPROPERTY(EditAnyWhere, BlueprintReadWrite, Category = "Squad movement")
 	float velocityIncreaser;
 
+	UPROPERTY(EditAnyWhere, BlueprintReadWrite, Category = "Squad movement")
+	float descendingStep; // Length of the descending step
+
 	AInvaderSquad();
 
 	UFUNCTION(BlueprintCallable)
 	void UpdateSquadState(float delta);
 
+	// Start of UpdateSquadState, on the game thread: applies pending decisions and snapshots the squad
+	void BeginUpdate();
+
+	// Middle of UpdateSquadState, after BeginUpdate: advances the march, the fire clock and the free-jump roll.
+	// Only reads the snapshot and writes data of this squad, so the squads of the game mode run it in parallel.
+	void PrepareUpdate(float delta);
+
+	// Pipelined BeginUpdate and PrepareUpdate: the decisions for the next frame are computed by a task from a
+	// snapshot of this frame, while the game thread goes on with the frame
+	void LaunchUpdate(float delta);
+
+	// Second half, on the game thread: moves the root, fires and starts the free jump decided by PrepareUpdate
+	// or LaunchUpdate (waiting for its task)
+	void ApplyUpdate();
+
 	UFUNCTION(BlueprintCallable)
 	float GetHorizontalVelocity();
 
@@ -49,6 +79,49 @@ public:
 	UFUNCTION(BlueprintCallable)
 	void IncrementVelocitySquad();
 
+	// Phase of the march (RIGHT, LEFT, DOWN or STOP) last pushed to the members in formation
+	UFUNCTION(BlueprintCallable)
+	InvaderMovementType GetState() const;
+
+	// Assets of the members, streamed in by the game mode before the squad is spawned
+	void GetAssetsToPreload(TArray<FSoftObjectPath>& assets) const;
+
+	// Every member has been spawned (see spawnBudgetMs)
+	UFUNCTION(BlueprintCallable)
+	bool IsMaterialized() const;
+
+	// Only before BeginPlay (deferred spawn), the members are spawned there
+	void SetSize(int32 rows, int32 cols);
+	int32 GetNumRows() const { return nRows; }
+	int32 GetNumCols() const { return nCols; }
+
+	// Transform the squad began play with, where a squad placed in the level is regenerated
+	const FTransform& GetStartTransform() const { return startTransform; }
+
+	UFUNCTION(BlueprintCallable)
+	int32 NumAlive() const;
+
+	// Overrides the fire rate of every living member
+	UFUNCTION(BlueprintCallable)
+	void SetMemberFireRate(float rate);
+
+	// Widens the field the squad marches in to its formation plus margin on each side (benchmarks with formations
+	// wider than the play field)
+	void WidenMarchField(float margin);
+
+	// Events of the game mode are routed to the squad with this id
+	int32 GetSquadId() const { return squadId; }
+	void SetSquadId(int32 id);
+
+	// The game mode calls PrepareUpdate/ApplyUpdate itself instead of the squad tick
+	void SetUpdatedByGameMode(bool bUpdated);
+
+	// Kills delivered by the game mode, positions in squad
+	void RemoveInvaders(TConstArrayView<int32> ids);
+
+	// Appends the movements of the free-jumpers the squad drives (bDriveMemberTicks), for a batched move
+	void GetDrivenFreeJumpers(TArray<class UInvaderMovementComponent*>& movements) const;
+
 public:
 	// Called every frame
 	virtual void Tick(float DeltaTime) override;
@@ -66,29 +139,113 @@ protected:
 	UPROPERTY(EditAnyWhere, BlueprintReadWrite, Category = "Squad Spawner")
 	float extraSeparation;
 
-	UPROPERTY(VisibleAnywhere, BlueprintReadWrite)
-	TArray<class AInvader*> SquadMembers;
+	// Invader bullets the bullet manager reserves room for in advance
+	UPROPERTY(EditAnyWhere, BlueprintReadWrite, Category = "Squad Spawner")
+	int32 bulletPoolSize;
+
+	// Invader explosions the effect manager creates in advance
+	UPROPERTY(EditAnyWhere, BlueprintReadWrite, Category = "Squad Spawner")
+	int32 explosionPoolSize;
+
+	UPROPERTY(VisibleAnywhere)
+	FInvaderRoster Roster;
+
+	// Members in formation don't tick: the squad tick carries them (see AInvader::SetDrivenBySquad)
+	UPROPERTY(EditAnyWhere, BlueprintReadWrite, Category = "Squad Spawner")
+	bool bDriveMemberTicks;
+
+	// Draw the squad with one instanced mesh per entry in InvaderMeshes instead of one mesh per invader.
+	// Invaders keep their own mesh component hidden; they have no collision, hits are tested by UBulletManager.
+	UPROPERTY(EditAnyWhere, BlueprintReadWrite, Category = "Squad Rendering")
+	bool bInstancedRendering;
+
+	// Members are spawned over several frames, at most this many milliseconds per frame (at least one member)
+	UPROPERTY(EditAnyWhere, BlueprintReadWrite, Category = "Squad Spawner")
+	float spawnBudgetMs;
 
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 	virtual void Destroyed() override;
 
 private:
-	int32 numberOfMembers;
-
 	UPROPERTY()
 	class AInvader* invaderTemplate;
 
-	float timeFromLastFreeJump;
+	int32 squadId;
+	bool bUpdatedByGameMode;
+	FTransform startTransform;
+
+	InvaderMovementType memberState = InvaderMovementType::STOP; // Game thread copy of the applied phase
+
+	// Decisions: Decide reads snapshot and writes decisions. While decisionTask runs it also owns rules; the game
+	// thread waits for it before touching them.
+	FSquadSnapshot snapshot;
+	FSquadDecisions decisions;
+	UE::Tasks::FTask decisionTask;
+
+	// Shots of the members killed while decisionTask ran, updated by the next ApplyUpdate
+	TArray<int32> deferredCancels; // Slots
+	TArray<int32> deferredColumns; // Columns that lost their front member
 
-	void SquadOnLeftSide();
+	void TakeSnapshot();
 
-	void SquadOnRightSide();
+	void Decide(float delta);
 
-	void SquadFinishesDown();
+	void WaitForDecisions();
 
 	void RemoveInvader(int32 ind);
 
+	// Instanced rendering
+	UPROPERTY()
+	TArray<class UInstancedStaticMeshComponent*> InstancedMeshes; // One per entry in InvaderMeshes
+
+	TArray<int32> slotInstances; // Instance index of every roster slot in the instanced mesh of its invader
+
+	void CreateInstancedMeshes();
+
+	void AddInvaderInstance(class AInvader* invader, int32 slot);
+
+	void HideInvaderInstance(int32 slot);
+
+	// Copies the transforms of the free-jumpers into their instances, one render update per mesh
+	void UpdateInstanceTransforms();
+
+	// Time-sliced spawn: the squad neither marches nor fires until every member is there
+	int32 nextSpawnSlot;
+	bool bMaterialized;
+
+	void SpawnMembers();
+
+	void FinishMaterializing();
+
+	// March, free jumps and fire, shared with the headless simulation (FInvaderSimulation). The layout is
+	// recorded when the members are spawned; both random streams are seeded from the game mode.
+	FSquadRules rules;
+
+	// Free-jumpers moved by the squad tick when the game mode does not update it
+	TArray<class UInvaderMovementComponent*> freeJumpers;
+	TArray<FInvaderKinematics> freeJumpKinematics;
+
+	// fireRate of the invader in slot, the rate the rules schedule its shots with
+	float GetSlotFireRate(int32 slot) const;
+
+	// Samples the next shot of slot from its invader fireRate
+	void ScheduleShot(int32 slot);
+
+	// Makes sure the front member of a column has its shot scheduled
+	void ScheduleColumn(int32 column);
+
+	void FireDueShots();
+
+	// Play field, taken from UBulletManager::GetPlayField()
+	FBox2D playField;
+
+	// Moves the squad root (and the members attached to it) by the step of the march
+	void MoveFormation(const FVector2D& offset);
+
+	void FindLimits();
+
 	UPROPERTY()
 	class ASIGameModeBase* MyGameMode;
 
@@ -98,4 +255,11 @@ private:
 	static constexpr const float defaultHorizontalVelocity = 1000.0f;
 	static constexpr const float defaultVerticalVelocity = 1000.0f;
 	static constexpr const float defaultExtraSeparation = 0.0f;
+	static constexpr const float defaultDescendingStep = 100.0f;
+	static const int32 defaultBulletPoolSize = 64;
+	static const int32 defaultExplosionPoolSize = 8;
+	static const int32 MaxInstancedMeshes = 16;
+	static constexpr const float defaultSpawnBudgetMs = 2.0f;
+	static const int32 recordedSpawnsPerFrame = 64; // Replaces the time budget in recorded sessions
+	static constexpr const float defaultMemberRadius = 50.0f; // Used when no InvaderMeshes is loaded
 };
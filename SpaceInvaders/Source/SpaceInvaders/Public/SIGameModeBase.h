@@ -4,12 +4,41 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/GameModeBase.h"
+#include "Engine/StreamableManager.h"
+#include "InvaderMovementComponent.h"
 #include "SIGameModeBase.generated.h"
 
 
+// Invaders of one class waiting for the next wave
+USTRUCT()
+struct FInvaderPool
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	TArray<class AInvader*> invaders;
+};
+
+// Gameplay events. Producers queue them and the game mode delivers them once per frame (see FlushEvents).
+enum class EGameplayEvent : uint8
+{
+	InvaderDestroyed, // value: position in squad
+	SquadSuccessful,
+	NewSquad, // value: player lifes. The squad is regenerated.
+	PlayerZeroLifes
+};
+
+struct FGameplayEvent
+{
+	EGameplayEvent type;
+	int32 value;
+	int32 squad; // Id of the squad the event belongs to (AInvaderSquad::GetSquadId), INDEX_NONE if none
+};
+
 DECLARE_DELEGATE(FStandardDelegateSignature)
 DECLARE_MULTICAST_DELEGATE_OneParam(FOneParamMulticastDelegateSignature, int32);
 DECLARE_DELEGATE_OneParam(FOneParamDelegateSignature, int32)
+DECLARE_MULTICAST_DELEGATE_OneParam(FIdsMulticastDelegateSignature, TConstArrayView<int32>);
 
 UCLASS()
 class SPACEINVADERS_API ASIGameModeBase : public AGameModeBase
@@ -29,22 +58,94 @@ public:
 	UPROPERTY(EditAnyWhere, BlueprintReadWrite, Category = "Level Layout")
 	FVector spawnLocation;
 
-	FStandardDelegateSignature SquadOnLeftSide; // Invader-> Squad 
-	FStandardDelegateSignature SquadOnRightSide; // Invader -> Squad
-	FStandardDelegateSignature SquadFinishesDown; // Invader -> Squad
-	FStandardDelegateSignature SquadSuccessful; // Invader -> GameMode
-	FOneParamMulticastDelegateSignature InvaderDestroyed; // Invader -> Squad Invader->Player
+	//------------------------------------------------
+	// Size of the spawned squads, 0 keeps the one of InvaderSquadClass
+	//------------------------------------------------
+	UPROPERTY(EditAnyWhere, BlueprintReadWrite, Category = "Level Layout")
+	int32 squadRows;
+
+	UPROPERTY(EditAnyWhere, BlueprintReadWrite, Category = "Level Layout")
+	int32 squadCols;
+
+	//------------------------------------------------
+	// Squads running at once, the i-th one is spawned at spawnLocation + i * squadSpacing
+	//------------------------------------------------
+	UPROPERTY(EditAnyWhere, BlueprintReadWrite, Category = "Level Layout")
+	int32 numSquads;
+
+	UPROPERTY(EditAnyWhere, BlueprintReadWrite, Category = "Level Layout")
+	FVector squadSpacing;
+
+	//------------------------------------------------
+	// Seed of the session, 0 picks a new one every time. Squads and invaders draw from streams seeded from it.
+	//------------------------------------------------
+	UPROPERTY(EditAnyWhere, BlueprintReadWrite, Category = "Random")
+	int32 randomSeed;
+
+	//------------------------------------------------
+	// Squad decisions are computed by tasks one frame ahead and applied the next frame, so the squads react
+	// one frame late to the side limits (edge reversal) and to reaching the bottom (landing).
+	// Off, they are computed and applied in the same frame.
+	//------------------------------------------------
+	UPROPERTY(EditAnyWhere, BlueprintReadWrite, Category = "Performance")
+	bool bPipelinedSquadDecisions;
+
+	FOneParamDelegateSignature SquadSuccessful; // Squad -> Player, with the id of the squad
+	FIdsMulticastDelegateSignature InvadersDestroyed; // Invader -> Squad Invader->Player, every kill of the frame at once
 
 	FOneParamMulticastDelegateSignature NewSquad; // Squad -> Game Mode
 	FStandardDelegateSignature PlayerZeroLifes; // Player -> Game Mode
 
 	ASIGameModeBase();
 
+	// Regenerates every squad (and spawns the missing ones up to numSquads)
 	UFUNCTION(BlueprintCallable)
 	void RegenerateSquad();
 
+	// Replaces the squad at index by a faster one
+	UFUNCTION(BlueprintCallable)
+	void RegenerateSquadAt(int32 index);
+
+	// First squad
+	UFUNCTION(BlueprintCallable)
+	AInvaderSquad* GetSquad() const;
+
+	const TArray<AInvaderSquad*>& GetSquads() const { return spawnedSquads; }
+
+	// Every squad registers when it begins play, also the ones placed in the level. Squads with no id get one,
+	// so the events of their members are routed to them.
+	void RegisterSquad(AInvaderSquad* squad);
+	void UnregisterSquad(AInvaderSquad* squad);
+
+	virtual void Tick(float DeltaSeconds) override;
+
+	// An invader like invaderTemplate at location: a pooled one if there is any, otherwise a new one.
+	// Its random stream is initialized with seed.
+	class AInvader* AcquireInvader(class AInvader* invaderTemplate, const FVector& location, const FRotator& rotation,
+	                               int32 seed);
+
+	// Keeps a dead invader (or a member of a dissolved squad) for the next wave instead of destroying it
+	void ReleaseInvader(class AInvader* invader);
+
+	// The subscribers get the event when the frame ends, never from inside the producer
+	void QueueEvent(EGameplayEvent type, int32 value = 0, int32 squad = INDEX_NONE);
+
+	// Delivers the queued events: the kills of every squad as one batch to that squad and all of them as one
+	// InvadersDestroyed batch, then the rest in order. Called once per frame after every actor and subsystem
+	// has ticked.
+	void FlushEvents();
+
+	int32 GetSessionSeed() const { return sessionSeed; }
+
+	// Seed for the random stream of a squad or invader, the same sequence for the same session seed
+	int32 NextSeed();
+
+	// Recorded or replayed by the USessionRecorder: nothing may depend on wall time
+	bool IsSessionRecorded() const;
+
 protected:
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 
 	// Delegate bindings
 	UFUNCTION(BlueprintCallable)
@@ -52,10 +153,59 @@ protected:
 
 	void EndGame();
 
+	AInvaderSquad* SpawnSquad(int32 index);
+
+	// Replaces a squad placed in the level by a faster one where it was placed. Like the original, it is
+	// not in spawnedSquads and updates itself.
+	void RegenerateLevelSquad(AInvaderSquad* squad);
+
+	// Squad states are computed in parallel (one task per squad), then applied to the actors on the game thread
+	// (see bPipelinedSquadDecisions)
+	void UpdateSquads(float delta);
+
+	// Moves the free-jumpers of the updated squads with UInvaderMovementComponent::MoveInvaders
+	void MoveFreeJumpers(float delta);
+
+	// Streams in the assets of the squad members and spawns the first squad when they are in memory
+	void PreloadSquadAssets();
+
 	UFUNCTION(BlueprintCallable)
 	void OnPlayerZeroLifes();
 
 private:
 	UPROPERTY(VisibleAnywhere)
-	AInvaderSquad* spawnedInvaderSquad;
+	TArray<AInvaderSquad*> spawnedSquads; // Indexed by spawn position, null until spawned
+
+	int32 nextSquadId;
+
+	UPROPERTY()
+	TArray<AInvaderSquad*> registeredSquads; // Squads playing, spawned by us or not
+	TArray<AInvaderSquad*> updatedSquads; // Scratch list of UpdateSquads
+
+	TArray<class UInvaderMovementComponent*> freeJumpers; // Scratch lists of MoveFreeJumpers
+	TArray<FInvaderKinematics> freeJumpKinematics;
+
+	AInvaderSquad* FindSquad(int32 squadId) const;
+
+	UPROPERTY()
+	TMap<UClass*, FInvaderPool> invaderPools; // By invader class
+
+	TSharedPtr<FStreamableHandle> squadAssetsHandle; // Keeps the preloaded assets in memory while the level runs
+
+	FRandomStream seedStream;
+	int32 sessionSeed;
+
+	UPROPERTY()
+	class USessionRecorder* Recorder;
+
+	TArray<FGameplayEvent> queuedEvents;
+	TArray<FGameplayEvent> deliveredEvents; // Events of the current flush, subscribers may queue new ones meanwhile
+	TArray<int32> destroyedBatch;
+	TArray<FGameplayEvent> squadKills; // Kills of the flush sorted by squad
+	TArray<int32> squadBatch;
+	FDelegateHandle postActorTickHandle;
+
+	void OnWorldPostActorTick(UWorld* world, ELevelTick tickType, float deltaSeconds);
+
+	static const int32 maxFlushPasses = 4; // Events queued by the subscribers are delivered in the same flush
 };
@@ -51,6 +51,10 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Defender config")
 	TSubclassOf<class ABullet> bulletClass;
 
+	// Player bullets the bullet manager reserves room for in advance
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Defender config")
+	int32 bulletPoolSize;
+
 	//Audios 
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Defender config")
 	class USoundCue* AudioShoot; // SoundCue para albergar el sonido del disparo.
@@ -71,9 +75,12 @@ public:
 
 	// Called every frame
 	virtual void Tick(float DeltaTime) override;
-	
-	// Overlaps
-	virtual void NotifyActorBeginOverlap(AActor* OtherActor) override;
+
+	// Hit by an invader bullet or crashed against an invader (tested by the UBulletManager)
+	void PlayerHit();
+
+	// Exploding after a hit, it can't be hit again
+	bool IsFrozen() const;
 
 	//Getters and Setters
 
@@ -83,6 +90,9 @@ public:
 	UFUNCTION(BlueprintCallable)
 	int32 GetLifes();
 
+	// Input of a recorded frame, given by the USessionRecorder while it replays a session
+	void ApplyRecordedInput(const struct FRecordedFrame& frame);
+
 protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
@@ -96,6 +106,13 @@ protected:
 	void OnEnhancedFire();
 
 	void OnEnhancedPause();
+
+	// Actions of the inputs, live or replayed
+	void Move(float axis);
+
+	void Fire();
+
+	void TogglePause();
 	// void OnMove(float value);
 
 	// void OnFire();
@@ -126,15 +143,21 @@ private:
 	
 	
 	UPROPERTY()
-	class ABullet* bulletTemplate; // Instancia de una bala que se usa como "molde" para un spawning eficiente.
+	class UBulletManager* BulletManager; // Mueve, dibuja y comprueba los impactos de las balas (no son actores).
+
+	UPROPERTY()
+	class UAudioVoiceManager* AudioManager; // Reproduce los sonidos con un conjunto compartido de voces.
+
+	UPROPERTY()
+	class UEffectManager* EffectManager; // Reutiliza los componentes de Niagara de las explosiones.
 
 	UPROPERTY()
-	class UAudioComponent* AudioComponent; // Reproductor de audio del Pawn.
+	class USessionRecorder* Recorder; // Graba o reproduce la entrada del jugador.
 
 	// Bindings to delegates
-	void InvaderDestroyed(int32 id);
+	void InvadersDestroyed(TConstArrayView<int32> ids);
 	void SquadDissolved(int32 val);
-	void SquadSuccessful();
+	void SquadSuccessful(int32 squadId);
 
 	static constexpr const TCHAR* defaultStaticMeshPath = TEXT("StaticMesh'/Engine/BasicShapes/Cube.Cube'");
 };
@@ -0,0 +1,87 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/GameInstanceSubsystem.h"
+#include "SessionRecorder.generated.h"
+
+// Input actions of the pawn, as bits of FRecordedFrame::actions
+enum class ESessionInput : uint8
+{
+	Move = 1 << 0,
+	Fire = 1 << 1,
+	Pause = 1 << 2
+};
+
+// One game frame: its delta time and the pawn input received during it
+struct FRecordedFrame
+{
+	float deltaTime = 0.0f;
+	float move = 0.0f; // Axis value, only stored when the Move bit is set
+	uint8 actions = 0;
+
+	bool Has(ESessionInput input) const { return (actions & (uint8)input) != 0; }
+};
+
+enum class ESessionMode : uint8
+{
+	Off,
+	Recording,
+	Replaying
+};
+
+/**
+ * Records a session (random seed, delta time of every frame and the input actions of the ASIPawn) to a compact
+ * binary file and replays it with the same seed, delta times and input, so a slow session can be profiled again.
+ * "SI.Record [name]" and "SI.Replay [name]" restart the level in that mode, "SI.StopRecording" saves the file.
+ * -SIRecord=name and -SIReplay=name do the same from the first level, with -unattended the game exits after
+ * the replay. Files are Saved/Replays/<name>.sireplay.
+ */
+UCLASS()
+class SPACEINVADERS_API USessionRecorder : public UGameInstanceSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	// Mode for the next session (the next level the game mode begins)
+	void StartRecording(const FString& name);
+	bool StartReplay(const FString& name);
+
+	// Called by the game mode when play begins. Returns the seed of the session: the recorded one when replaying.
+	int32 BeginSession(UWorld* world, int32 seed);
+
+	// Called by the game mode when play ends. Saves the recording.
+	void EndSession();
+
+	ESessionMode GetMode() const { return mode; }
+	bool IsSessionActive() const { return sessionWorld.IsValid(); }
+
+	// Live input of the pawn. It is recorded, and ignored while replaying (the recording drives the pawn).
+	bool OnLiveInput(ESessionInput input, float value = 0.0f);
+
+private:
+	ESessionMode mode = ESessionMode::Off;
+	FString path;
+	int32 sessionSeed = 0;
+	TArray<FRecordedFrame> frames;
+	int32 replayFrame = 0;
+
+	TWeakObjectPtr<UWorld> sessionWorld;
+	FDelegateHandle preActorTickHandle;
+
+	void OnWorldPreActorTick(UWorld* world, ELevelTick tickType, float deltaSeconds);
+	void FinishReplay();
+
+	bool Save() const;
+	bool Load();
+
+	static FString GetPath(const FString& name);
+
+	static const uint32 fileMagic = 0x50524953; // "SIRP"
+	static const uint8 fileVersion = 1;
+	static const int32 minFrameSize = 5; // Delta time and actions, the move axis is optional
+};
@@ -0,0 +1,99 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Uniform grid over the XY play plane, hashed into a fixed number of buckets.
+ * It is rebuilt from scratch every frame: Add() the circles, Build() (a counting sort by bucket)
+ * and then Query() the candidates near a point. Buffers are reused, so once warmed up a rebuild
+ * does not allocate.
+ */
+class SPACEINVADERS_API FSpatialHash
+{
+public:
+	// Empties the grid. Cells are cellSize wide; expectedEntries sizes the bucket table.
+	void Reset(float cellSize, int32 expectedEntries);
+
+	// Adds a circle identified by id (e.g. an index in the caller's array)
+	void Add(int32 id, const FVector2D& position, float radius);
+
+	// Sorts the entries by bucket. Must be called after the last Add() and before any Query().
+	void Build();
+
+	int32 Num() const { return entries.Num(); }
+
+	/**
+	 * Calls visitor(id, position, radius) for every entry that may overlap the circle (position, radius),
+	 * until the visitor returns true. Entries of other cells sharing a bucket are visited too, so the
+	 * visitor has to do the exact test. Returns true if the visitor stopped the query.
+	 */
+	template <typename VisitorType>
+	bool Query(const FVector2D& position, float radius, VisitorType&& visitor) const
+	{
+		if (entries.Num() == 0)
+			return false;
+
+		// Entries are stored in the cell of their center: widen the search by the largest radius
+		const float reach = radius + maxRadius;
+		const int32 minX = CellCoord(position.X - reach);
+		const int32 maxX = CellCoord(position.X + reach);
+		const int32 minY = CellCoord(position.Y - reach);
+		const int32 maxY = CellCoord(position.Y + reach);
+		for (int32 cx = minX; cx <= maxX; cx++)
+		{
+			for (int32 cy = minY; cy <= maxY; cy++)
+			{
+				const int32 bucket = BucketOf(cx, cy);
+				for (int32 e = bucketStart[bucket]; e < bucketStart[bucket + 1]; e++)
+				{
+					const FEntry& entry = sorted[e];
+					if (visitor(entry.id, FVector2D(entry.position), entry.radius))
+						return true;
+				}
+			}
+		}
+		return false;
+	}
+
+	// Id of an entry whose circle overlaps (position, radius) and passes filter(id), INDEX_NONE if there is none
+	template <typename FilterType>
+	int32 FindOverlap(const FVector2D& position, float radius, FilterType&& filter) const
+	{
+		int32 found = INDEX_NONE;
+		Query(position, radius, [&](int32 id, const FVector2D& entryPosition, float entryRadius)
+		{
+			if (FVector2D::DistSquared(position, entryPosition) > FMath::Square(radius + entryRadius) || !filter(id))
+				return false;
+			found = id;
+			return true;
+		});
+		return found;
+	}
+
+private:
+	struct FEntry
+	{
+		FVector2f position;
+		float radius;
+		int32 id;
+		int32 bucket;
+	};
+
+	float cellSize = 1.0f;
+	float invCellSize = 1.0f;
+	float maxRadius = 0.0f;
+	int32 bucketMask = 0;
+
+	TArray<FEntry> entries; // In insertion order
+	TArray<FEntry> sorted; // Grouped by bucket after Build()
+	TArray<int32> bucketStart; // sorted[bucketStart[b] .. bucketStart[b + 1]) are the entries of bucket b
+
+	int32 CellCoord(float value) const { return FMath::FloorToInt32(value * invCellSize); }
+
+	int32 BucketOf(int32 cx, int32 cy) const
+	{
+		return (int32)(((uint32)cx * 73856093u) ^ ((uint32)cy * 19349663u)) & bucketMask;
+	}
+};
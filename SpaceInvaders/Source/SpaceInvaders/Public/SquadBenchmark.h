@@ -0,0 +1,95 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "FrameTimings.h"
+#include "SquadBenchmark.generated.h"
+
+// Average game-thread cost of one frame with a squad of numInvaders
+struct FSquadBenchmarkResult
+{
+	int32 numInvaders = 0;
+	int32 frames = 0;
+	bool bScopedMovement = true; // UInvaderMovementComponent::bScopedMovementUpdates during the run
+	double frameMs = 0.0; // Wall time between two frames
+	double sectionMs[(int32)EFrameSection::Num] = {};
+	double bulletsFlying = 0.0;
+};
+
+/**
+ * Squad-size scaling benchmark. "SI.ScalingBenchmark [frames] [invaders...]" replaces the squad of the game mode
+ * by squads of growing size (10, 100, 1000 and 5000 invaders by default) with forced fire and free-jump rates,
+ * measures frames frames of each one split in EFrameSection and writes the averages to
+ * Saved/Benchmarks/SquadScaling_<date>.csv and .json. With bCompareMovementUpdates every size is measured with
+ * the plain SetActorTransform writes and then with the teleporting scoped ones (see
+ * UInvaderMovementComponent::bScopedMovementUpdates), and the savings of the free-jumpers and of the root move of
+ * the marching formation are logged.
+ * The automation test SpaceInvaders.Benchmark.SquadScaling runs the default sweep headless:
+ * UnrealEditor SpaceInvaders.uproject -game -nullrhi -unattended
+ *     -ExecCmds="Automation RunTests SpaceInvaders.Benchmark.SquadScaling; Quit"
+ */
+UCLASS()
+class SPACEINVADERS_API USquadBenchmark : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	// False if there is no ASIGameModeBase or another run is going on
+	bool Start(int32 framesPerSize, const TArray<int32>& sizes);
+
+	bool IsRunning() const { return sizeIndex != INDEX_NONE; }
+
+	// Averages of the last run, one per size (two with bCompareMovementUpdates)
+	const TArray<FSquadBenchmarkResult>& GetResults() const { return results; }
+
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+	virtual bool IsTickable() const override;
+
+	// Forced rates, far above the game ones so every size fires and breaks formation during the run
+	float fireRate = 0.5f;
+	float freeJumpRate = 5.0f;
+	float playerFireInterval = 0.1f;
+	float marchMargin = 1000.0f; // Room the squad walks on each side of its formation
+
+	// Measures every size twice, without and with UInvaderMovementComponent::bScopedMovementUpdates
+	bool bCompareMovementUpdates = true;
+
+	// Quit the game when the run is done and it runs with -unattended (SI.ScalingBenchmark from -ExecCmds)
+	bool bExitWhenUnattended = false;
+
+	// Sweep of SI.ScalingBenchmark with no arguments and of the automation test
+	static const TArray<int32> defaultSizes;
+	static const int32 defaultFramesPerSize = 300;
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	TArray<int32> sweep;
+	int32 sizeIndex = INDEX_NONE;
+	int32 framesPerSize = 0;
+	int32 warmupFrames = 0; // Frames left before measuring the current size
+	double lastFrameTime = 0.0;
+	float timeFromLastPlayerShot = 0.0f;
+	int32 savedPlayerLifes = 0;
+	int32 movementPass = 0; // 0 old movement writes, 1 scoped ones (bCompareMovementUpdates)
+	bool bSavedScopedMovement = true;
+
+	UPROPERTY()
+	class AInvaderSquad* BenchmarkSquad = nullptr; // Squad with the forced rates applied
+
+	FSquadBenchmarkResult current;
+	TArray<FSquadBenchmarkResult> results;
+
+	void StartSize();
+	void PrepareSquad();
+	void FirePlayerBullet(float DeltaTime);
+	void Finish();
+	void WriteResults() const;
+	static void LogMovementSavings(const FSquadBenchmarkResult& before, const FSquadBenchmarkResult& after);
+
+	static const int32 defaultWarmupFrames = 30;
+};
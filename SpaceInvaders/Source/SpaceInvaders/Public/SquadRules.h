@@ -0,0 +1,104 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "FormationSlots.h"
+#include "FormationMarch.h"
+#include "FireScheduler.h"
+
+// Chance that an event happening rate times per second has happened after elapsed seconds.
+// The free-jump roll uses it every step; fire is scheduled by FFireScheduler.
+inline float ExponentialChance(float rate, float elapsed)
+{
+	return 1.0f - FMath::Exp(-rate * elapsed);
+}
+
+// Squad settings a step of FSquadRules reads
+struct FSquadStepParams
+{
+	float horizontalVelocity = 0.0f;
+	float verticalVelocity = 0.0f;
+	float descendingStep = 0.0f;
+	float freeJumpRate = 0.0f;
+};
+
+// What one step of FSquadRules decided, applied to the members by the caller
+struct FSquadStepResult
+{
+	EMarchPhase phase = EMarchPhase::Stop; // Phase the members in formation follow during the step
+	FVector2D offset = FVector2D::ZeroVector; // Step of the squad root
+	bool bLanded = false; // The formation reached the bottom
+	int32 freeJump = INDEX_NONE; // Slot that starts a free jump, INDEX_NONE if nobody jumps
+};
+
+/**
+ * The rules of a squad without any actor: the march and its limits, the free-jump roll and the fire schedule
+ * (the front-most member in formation of every column and the free-jumpers shoot). AInvaderSquad and
+ * FInvaderSimulation run the same step every frame and apply its result to their own members.
+ * Fire rates are per member, so the calls that schedule shots take rateOf(slot).
+ */
+struct SPACEINVADERS_API FSquadRules
+{
+	FFormationLayout layout;
+	FFormationMarch march;
+	float timeFromLastFreeJump = 0.0f;
+	FRandomStream random; // Free jumps
+
+	FFireScheduler fireScheduler;
+	FRandomStream fireRandom;
+	float fireClock = 0.0f; // Seconds since the squad began play, the time base of fireScheduler
+
+	// Every member has been placed: the march starts to the right and every column schedules its front shot
+	template <typename RateType>
+	void Start(const FFormationSlots& slots, RateType&& rateOf)
+	{
+		fireScheduler.Reset(slots.Num());
+		for (int32 column = 0; column < layout.columnOffsets.Num(); column++)
+			ScheduleColumn(slots, column, rateOf);
+		march.phase = EMarchPhase::Right; // Start with Right phase
+	}
+
+	/**
+	 * Advances the march by delta, turns it around at the side limits of playField, pops the shots due into
+	 * dueShooters and rolls the free jump. Only reads slots, so it can run on a copy of them in a task.
+	 * The due shooters are popped first and rescheduled by the caller once they fire, so a shooter fires at
+	 * most once per step.
+	 */
+	FSquadStepResult Step(const FFormationSlots& slots, const FVector2D& rootLocation, const FSquadStepParams& params,
+	                      const FBox2D& playField, float delta, TArray<int32>& dueShooters);
+
+	// Samples the next shot of slot
+	void ScheduleShot(int32 slot, float rate)
+	{
+		fireScheduler.Schedule(slot, fireClock + FFireScheduler::SampleDelay(rate, fireRandom.FRand()));
+	}
+
+	// Makes sure the front member of a column has its shot scheduled
+	template <typename RateType>
+	void ScheduleColumn(const FFormationSlots& slots, int32 column, RateType&& rateOf)
+	{
+		int32 front = slots.FindFrontInColumn(column);
+		if (front != INDEX_NONE && !fireScheduler.IsScheduled(front))
+			ScheduleShot(front, rateOf(front));
+	}
+
+	// slot left the formation (slots already marked): free-jumpers always fire, and the next one in its column
+	// takes its place
+	template <typename RateType>
+	void StartFreeJump(const FFormationSlots& slots, int32 slot, RateType&& rateOf)
+	{
+		ScheduleShot(slot, rateOf(slot));
+		ScheduleColumn(slots, slots.GetColumn(slot), rateOf);
+	}
+
+	// slot died (slots already marked): its shot is cancelled and, if it was the front of its column, the next
+	// one fires instead
+	template <typename RateType>
+	void KillMember(const FFormationSlots& slots, int32 slot, bool bWasInFormation, RateType&& rateOf)
+	{
+		fireScheduler.Cancel(slot);
+		if (bWasInFormation)
+			ScheduleColumn(slots, slots.GetColumn(slot), rateOf);
+	}
+};
@@ -3,4 +3,33 @@
 #include "SpaceInvaders.h"
 #include "Modules/ModuleManager.h"
 
+DEFINE_LOG_CATEGORY(LogSpaceInvaders);
+
+UE_TRACE_CHANNEL_DEFINE(SpaceInvadersChannel);
+
+DEFINE_STAT(STAT_SI_SquadUpdate);
+DEFINE_STAT(STAT_SI_SquadSpawn);
+DEFINE_STAT(STAT_SI_InvaderTick);
+DEFINE_STAT(STAT_SI_InvaderFire);
+DEFINE_STAT(STAT_SI_InvaderMovement);
+DEFINE_STAT(STAT_SI_FreeJumpPoses);
+DEFINE_STAT(STAT_SI_BulletIntegrate);
+DEFINE_STAT(STAT_SI_HitTests);
+DEFINE_STAT(STAT_SI_BulletInstances);
+DEFINE_STAT(STAT_SI_SimulationStep);
+DEFINE_STAT(STAT_SI_EventFlush);
+DEFINE_STAT(STAT_SI_SquadDecisionWait);
+
+DEFINE_STAT(STAT_SI_LiveInvaders);
+DEFINE_STAT(STAT_SI_LiveBullets);
+DEFINE_STAT(STAT_SI_ActorSpawns);
+DEFINE_STAT(STAT_SI_BulletsFired);
+DEFINE_STAT(STAT_SI_Broadcasts);
+DEFINE_STAT(STAT_SI_EventsQueued);
+DEFINE_STAT(STAT_SI_SoundsPlayed);
+DEFINE_STAT(STAT_SI_SoundsCulled);
+DEFINE_STAT(STAT_SI_EffectsStarted);
+DEFINE_STAT(STAT_SI_EffectsMerged);
+DEFINE_STAT(STAT_SI_EffectsDropped);
+
 IMPLEMENT_PRIMARY_GAME_MODULE( FDefaultGameModuleImpl, SpaceInvaders, "SpaceInvaders" );
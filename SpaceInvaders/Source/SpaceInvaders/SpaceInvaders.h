@@ -3,4 +3,43 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "Stats/Stats.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
 
+DECLARE_LOG_CATEGORY_EXTERN(LogSpaceInvaders, Log, All);
+
+// "stat SpaceInvaders" in game, and the SpaceInvaders channel in Unreal Insights (-trace=cpu,SpaceInvaders)
+DECLARE_STATS_GROUP(TEXT("SpaceInvaders"), STATGROUP_SpaceInvaders, STATCAT_Advanced);
+UE_TRACE_CHANNEL_EXTERN(SpaceInvadersChannel, SPACEINVADERS_API);
+
+// Hot paths
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Squad update"), STAT_SI_SquadUpdate, STATGROUP_SpaceInvaders, SPACEINVADERS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Squad spawn"), STAT_SI_SquadSpawn, STATGROUP_SpaceInvaders, SPACEINVADERS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Invader tick"), STAT_SI_InvaderTick, STATGROUP_SpaceInvaders, SPACEINVADERS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Invader fire"), STAT_SI_InvaderFire, STATGROUP_SpaceInvaders, SPACEINVADERS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Invader movement"), STAT_SI_InvaderMovement, STATGROUP_SpaceInvaders, SPACEINVADERS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Free jump poses"), STAT_SI_FreeJumpPoses, STATGROUP_SpaceInvaders, SPACEINVADERS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Bullet integration"), STAT_SI_BulletIntegrate, STATGROUP_SpaceInvaders, SPACEINVADERS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Hit tests"), STAT_SI_HitTests, STATGROUP_SpaceInvaders, SPACEINVADERS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Bullet instances"), STAT_SI_BulletInstances, STATGROUP_SpaceInvaders, SPACEINVADERS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Simulation step"), STAT_SI_SimulationStep, STATGROUP_SpaceInvaders, SPACEINVADERS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Event flush"), STAT_SI_EventFlush, STATGROUP_SpaceInvaders, SPACEINVADERS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Squad decision wait"), STAT_SI_SquadDecisionWait, STATGROUP_SpaceInvaders, SPACEINVADERS_API);
+
+// Live objects (set every frame) and events (cleared every frame)
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Live invaders"), STAT_SI_LiveInvaders, STATGROUP_SpaceInvaders, SPACEINVADERS_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Live bullets"), STAT_SI_LiveBullets, STATGROUP_SpaceInvaders, SPACEINVADERS_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Actors spawned"), STAT_SI_ActorSpawns, STATGROUP_SpaceInvaders, SPACEINVADERS_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Bullets fired"), STAT_SI_BulletsFired, STATGROUP_SpaceInvaders, SPACEINVADERS_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Delegate broadcasts"), STAT_SI_Broadcasts, STATGROUP_SpaceInvaders, SPACEINVADERS_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Events queued"), STAT_SI_EventsQueued, STATGROUP_SpaceInvaders, SPACEINVADERS_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Sounds played"), STAT_SI_SoundsPlayed, STATGROUP_SpaceInvaders, SPACEINVADERS_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Sounds culled"), STAT_SI_SoundsCulled, STATGROUP_SpaceInvaders, SPACEINVADERS_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Effects started"), STAT_SI_EffectsStarted, STATGROUP_SpaceInvaders, SPACEINVADERS_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Effects merged"), STAT_SI_EffectsMerged, STATGROUP_SpaceInvaders, SPACEINVADERS_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Effects dropped"), STAT_SI_EffectsDropped, STATGROUP_SpaceInvaders, SPACEINVADERS_API);
+
+// Cycle counter of the stat plus an Insights event with the same name on SpaceInvadersChannel
+#define SI_SCOPE_CYCLE_COUNTER(Stat) \
+	SCOPE_CYCLE_COUNTER(Stat); \
+	TRACE_CPUPROFILER_EVENT_SCOPE_ON_CHANNEL(Stat, SpaceInvadersChannel)